@@ -42,16 +42,6 @@ LOG_FILE_SOURCE(debug::LOG_MODEM);
 
 using namespace std;
 
-double contestia::nco(double freq)
-{
-    preamblephase += 2.0 * M_PI * freq / samplerate;
-
-	if (preamblephase > M_PI)
-		preamblephase -= 2.0 * M_PI;
-
-	return cos(preamblephase);
-}
-
 void contestia::tx_init(SoundBase *sc)
 {
 	unsigned char c;
@@ -100,13 +90,15 @@ void contestia::send_tones()
 		freqb = tone_midfreq + (tone_bw / 2.0); 
 	}
 
-	preamblephase = 0;
-	for (int i = 0; i < SR4; i++)
-		tonebuff[2*SR4 + i] = tonebuff[i] = nco(freqa) * ampshape[i];
+	preambleosc.reset();
+	preambleosc.set_freq(freqa, samplerate);
+	preambleosc.fill_cos(tonebuff, SR4, ampshape);
+	memcpy(&tonebuff[2*SR4], tonebuff, SR4 * sizeof(*tonebuff));
 
-	preamblephase = 0;
-	for (int i = 0; i < SR4; i++)
-		tonebuff[3*SR4 + i] = tonebuff[SR4 + i] = nco(freqb) * ampshape[i];
+	preambleosc.reset();
+	preambleosc.set_freq(freqb, samplerate);
+	preambleosc.fill_cos(&tonebuff[SR4], SR4, ampshape);
+	memcpy(&tonebuff[3*SR4], &tonebuff[SR4], SR4 * sizeof(*tonebuff));
 
 	for (int j = 0; j < TONE_DURATION; j += SCBLOCKSIZE)
 		ModulateXmtr(&tonebuff[j], SCBLOCKSIZE);
@@ -48,11 +48,15 @@
 #include "status.h"
 #include "debug.h"
 #include "FTextRXTX.h"
+#include "trx.h"
+#include "view_cw.h"
 
 #include "qrunner.h"
 
 using namespace std;
 
+view_cw *cwviewer = (view_cw *)0;
+
 const cw::SOM_TABLE cw::som_table[] = {
 	/* Prosigns */
 	{'=',	"<BT>",   {1.0,  0.33,  0.33,  0.33, 1.0,   0, 0}	}, // 0
@@ -179,8 +183,9 @@ void cw::tx_init(SoundBase *sc)
 {
 	scard = sc;
 	phaseacc = 0;
+	txosc.reset();
 	lastsym = 0;
-	qskphase = 0;
+	qskosc.reset();
 }
 
 void cw::rx_init()
@@ -222,11 +227,13 @@ void cw::init()
 	use_paren = progdefaults.CW_use_paren;
 	prosigns = progdefaults.CW_prosigns;
 	stopflag = false;
+	cwviewer->restart();
 }
 
 cw::~cw() {
 	if (hilbert) delete hilbert;
 	if (cw_FIR_filter) delete cw_FIR_filter;
+	if (cw_decimator) delete cw_decimator;
 	if (cw_FFT_filter) delete cw_FFT_filter;
 	if (bitfilter) delete bitfilter;
 	if (trackingfilter) delete trackingfilter;
@@ -271,8 +278,8 @@ cw::cw() : modem()
 
 	cwTrack = true;
 	phaseacc = 0.0;
-	FFTphase = 0.0;
-	FIRphase = 0.0;
+	FFTosc.reset();
+	FIRosc.reset();
 	FFTvalue = 0.0;
 	FIRvalue = 0.0;
 	pipeptr = 0;
@@ -298,9 +305,14 @@ cw::cw() : modem()
 	cw_FIR_filter = new C_FIR_filter();
 	cw_FIR_filter->init_lowpass (CW_FIRLEN, DEC_RATIO, 0.5 * bandwidth / samplerate);
 
+// the FFT filter runs after decimation, so nothing is computed for the
+// samples that the timing code would throw away
+	cw_decimator = new C_FIR_filter();
+	cw_decimator->init_lowpass (CW_DECLEN, DEC_RATIO, 0.5 / DEC_RATIO);
+
 //overlap and add filter length should be a factor of 2
-	FilterFFTLen = 4096;
-	cw_FFT_filter = new fftfilt(0.5 * bandwidth / samplerate, FilterFFTLen); // low pass implementation
+	FilterFFTLen = 4096 / DEC_RATIO;
+	cw_FFT_filter = new fftfilt(0.5 * bandwidth * DEC_RATIO / samplerate, FilterFFTLen); // low pass implementation
 
 // bit filter based on 10 msec rise time of CW waveform
 	int bfv = (int)(samplerate * .010 / DEC_RATIO);
@@ -308,6 +320,8 @@ cw::cw() : modem()
 
 	trackingfilter = new Cmovavg(TRACKING_FILTER_SIZE);
 
+	if (!::cwviewer) ::cwviewer = new view_cw;
+
 	makeshape();
 	sync_parameters();
 	REQ(static_cast<void (waterfall::*)(int)>(&waterfall::Bandwidth), wf, (int)bandwidth);
@@ -333,11 +347,11 @@ void cw::reset_rx_filter()
 			bandwidth = progdefaults.CWbandwidth;
 
 		if (use_fft_filter) { // FFT filter
-			cw_FFT_filter->create_lpf(0.5 * bandwidth / samplerate);
-			FFTphase = 0;
+			cw_FFT_filter->create_lpf(0.5 * bandwidth * DEC_RATIO / samplerate);
+			FFTosc.reset();
 		} else { // FIR filter
 			cw_FIR_filter->init_lowpass (CW_FIRLEN, DEC_RATIO, 0.5 * bandwidth / samplerate);
-			FIRphase = 0;
+			FIRosc.reset();
 		}
 		REQ(static_cast<void (waterfall::*)(int)>(&waterfall::Bandwidth),
 			wf, (int)bandwidth);
@@ -356,8 +370,8 @@ void cw::reset_rx_filter()
 		fsymlen = (int)(samplerate * 1.2 / progdefaults.CWfarnsworth);
 
 		phaseacc = 0.0;
-		FFTphase = 0.0;
-		FIRphase = 0.0;
+		FFTosc.reset();
+		FIRosc.reset();
 		FFTvalue = 0.0;
 		FIRvalue = 0.0;
 		pipeptr = 0;
@@ -604,26 +618,25 @@ void cw::rx_FFTprocess(const double *buf, int len)
 	complex z, *zp;
 	int n;
 
+	FFTosc.set_freq(frequency, samplerate);
+
 	while (len-- > 0) {
 
-		z = complex ( *buf * cos(FFTphase), *buf * sin(FFTphase) );
-		FFTphase += TWOPI * frequency / samplerate;
-		if (FFTphase > M_PI)
-			FFTphase -= TWOPI;
-		else if (FFTphase < M_PI)
-			FFTphase += TWOPI;
+		z = complex ( *buf * FFTosc.cos(), *buf * FFTosc.sin() );
+		FFTosc.step();
 
 		buf++;
 
+// decimate by DEC_RATIO; only the samples that are kept get computed
+		if (!cw_decimator->run(z, z)) continue;
+
 		n = cw_FFT_filter->run(z, &zp); // n = 0 or filterlen/2
 
 		if (!n) continue;
 
 		for (int i = 0; i < n; i++) {
 // update the basic sample counter used for morse timing
-			++smpl_ctr;
-
-			if (smpl_ctr % DEC_RATIO) continue; // decimate by DEC_RATIO
+			smpl_ctr += DEC_RATIO;
 
 // demodulate
 			FFTvalue = zp[i].mag();
@@ -640,15 +653,13 @@ void cw::rx_FIRprocess(const double *buf, int len)
 {
 	complex z;
 
+	FIRosc.set_freq(frequency, samplerate);
+
 	while (len-- > 0) {
-		z = complex ( *buf * cos(FIRphase), *buf * sin(FIRphase) );
+		z = complex ( *buf * FIRosc.cos(), *buf * FIRosc.sin() );
 		buf++;
 
-		FIRphase += TWOPI * frequency / samplerate;
-		if (FIRphase > M_PI)
-			FIRphase -= TWOPI;
-		else if (FIRphase < M_PI)
-			FIRphase += TWOPI;
+		FIRosc.step();
 
 		if (cw_FIR_filter->run ( z, z )) {
 
@@ -676,6 +687,8 @@ int cw::rx_process(const double *buf, int len)
 	else
 		rx_FIRprocess(buf, len);
 
+	if (cwviewer && !bHistory) cwviewer->rx_process(buf, len);
+
 	if (!clrcount--) clear_syncscope();
 
 	display_metric(metric);
@@ -901,26 +914,6 @@ void cw::makeshape()
 	}
 }
 
-inline double cw::nco(double freq)
-{
-	phaseacc += 2.0 * M_PI * freq / samplerate;
-
-	if (phaseacc > M_PI)
-		phaseacc -= 2.0 * M_PI;
-
-	return sin(phaseacc);
-}
-
-inline double cw::qsknco()
-{
-	qskphase += 2.0 * M_PI * 1000 / samplerate;
-
-	if (qskphase > M_PI)
-		qskphase -= 2.0 * M_PI;
-
-	return sin(qskphase);
-}
-
 //=====================================================================
 // send_symbol()
 // Sends a part of a morse character (one dot duration) of either
@@ -941,7 +934,7 @@ int q_carryover = 0, carryover = 0;
 void cw::send_symbol(int bits, int len)
 {
 	double freq;
-	int sample, qsample, i;
+	int sample, qsample;
 	int delta = 0;
 	int keydown;
 	int keyup;
@@ -953,6 +946,8 @@ void cw::send_symbol(int bits, int len)
 	int currsym = bits & 1;
 
 	freq = get_txfreq_woffset();
+	txosc.set_freq(freq, samplerate);
+	qskosc.set_freq(1000, samplerate);
 
 	delta = (int) (len * (progdefaults.CWweight - 50) / 100.0);
 
@@ -998,28 +993,19 @@ void cw::send_symbol(int bits, int len)
 	if (currsym == 1) { // keydown
 		sample = 0;
 		if (lastsym == 1) {
-			for (i = 0; i < keydown; i++, sample++) {
-				outbuf[sample] = nco(freq);
-				qskbuf[sample] = qsknco();
-			}
+			txosc.fill_sin(outbuf, keydown);
+			qskosc.fill_sin(qskbuf, keydown);
 			duration = keydown;
 		} else {
 			if (carryover) {
 				for (int i = carryover; i < knum; i++, sample++)
-					outbuf[sample] = nco(freq) * keyshape[knum - i];
-				while (sample < kpre)
-					outbuf[sample++] = 0 * nco(freq);
+					outbuf[sample] = txosc.next_sin() * keyshape[knum - i];
+				txosc.fill_zero(outbuf + sample, kpre - sample);
 			} else
-				for (int i = 0; i < kpre; i++, sample++)
-					outbuf[sample] = 0 * nco(freq);
-			sample = 0;
-			for (int i = 0; i < kpre; i++, sample++) {
-				qskbuf[sample] = qsknco();
-			}
-			for (int i = 0; i < knum; i++, sample++) {
-				outbuf[sample] = nco(freq) * keyshape[i];
-				qskbuf[sample] = qsknco();
-			}
+				txosc.fill_zero(outbuf, kpre);
+			qskosc.fill_sin(qskbuf, kpre);
+			txosc.fill_sin(outbuf + kpre, knum, keyshape);
+			qskosc.fill_sin(qskbuf + kpre, knum);
 			duration = kpre + knum;
 		}
 		carryover = 0;
@@ -1030,24 +1016,17 @@ void cw::send_symbol(int bits, int len)
 			sample = 0;
 			if (carryover) {
 				for (int i = carryover; i < knum; i++, sample++)
-					outbuf[sample] = nco(freq) * keyshape[knum - i];
-				while (sample < duration)
-					outbuf[sample++] = 0 * nco(freq);
-			} else
-				while (sample < duration)
-					outbuf[sample++] = 0 * nco(freq);
+					outbuf[sample] = txosc.next_sin() * keyshape[knum - i];
+			}
+			txosc.fill_zero(outbuf + sample, duration - sample);
 			carryover = 0;
 
 			qsample = 0;
 			if (q_carryover) {
-				for (int i = 0; i < q_carryover; i++, qsample++) {
-					qskbuf[qsample] = qsknco();
-				}
-				while (qsample < duration)
-					qskbuf[qsample++] = 0 * qsknco();
-			} else
-				while (qsample < duration)
-					qskbuf[qsample++] = 0 * qsknco();
+				qskosc.fill_sin(qskbuf, q_carryover);
+				qsample = q_carryover;
+			}
+			qskosc.fill_zero(qskbuf + qsample, duration - qsample);
 			if (q_carryover > duration)
 				q_carryover = duration - q_carryover;
 			else
@@ -1062,18 +1041,19 @@ void cw::send_symbol(int bits, int len)
 			if (progdefaults.CWnarrow)
 				next = keydown - 2*knum;
 
-			for (int i = 0; i < next; i++, sample++)
-				outbuf[sample] = nco(freq);
+			if (next > 0) {
+				txosc.fill_sin(outbuf, next);
+				sample = next;
+			}
 
 			for (int i = 0; i < knum; i++, sample++) {
 				if (sample == duration) {
 					carryover = i;
 					break;
 				}
-				outbuf[sample] = nco(freq) * keyshape[knum - i];
+				outbuf[sample] = txosc.next_sin() * keyshape[knum - i];
 			}
-			while (sample < duration)
-				outbuf[sample++] = 0 * nco(freq);
+			txosc.fill_zero(outbuf + sample, duration - sample);
 
 			q_carryover = 0;
 			qsample = 0;
@@ -1083,10 +1063,9 @@ void cw::send_symbol(int bits, int len)
 					q_carryover = kpost - duration;
 					break;
 				}
-				qskbuf[qsample] = qsknco();
+				qskbuf[qsample] = qskosc.next_sin();
 			}
-			while (qsample < duration)
-				qskbuf[qsample++] = 0 * qsknco();
+			qskosc.fill_zero(qskbuf + qsample, duration - qsample);
 		}
 	}
 
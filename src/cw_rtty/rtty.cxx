@@ -39,7 +39,7 @@ using namespace std;
 #include "digiscope.h"
 #include "trx.h"
 
-#include "dl_fldigi/hbtint.h"
+#include "dl_fldigi/extract.h"
 
 view_rtty *rttyviewer = (view_rtty *)0;
 
@@ -103,6 +103,7 @@ void rtty::tx_init(SoundBase *sc)
 // start each new transmission 20 bit lengths MARK tone
 	scard = sc;
 	phaseacc = 0;
+	txosc.reset();
 	preamble = 20;
 	videoText();
 }
@@ -112,7 +113,7 @@ void rtty::rx_init()
 	rxstate = RTTY_RX_STATE_IDLE;
 	rxmode = LETTERS;
 	phaseacc = 0;
-	FSKphaseacc = 0;
+	FSKosc.reset();
 	for (int i = 0; i < RTTYMaxSymLen; i++ ) {
 		bbfilter[i] = 0.0;
 	}
@@ -432,13 +433,8 @@ bool rtty::rx(bool bit)
 					/* HOOKS */
 					put_rx_ssdv(c, lb);
 
-					if (lb != 0)
-						dl_fldigi::hbtint::extrmgr->skipped(lb);
-
-					if (nbits == 5)
-						dl_fldigi::hbtint::extrmgr->push(c, habitat::PUSH_BAUDOT_HACK);
-					else
-						dl_fldigi::hbtint::extrmgr->push(c);
+					dl_fldigi::extract::skipped(lb);
+					dl_fldigi::extract::push(c, nbits == 5);
 
 					if ( c != 0 )
 						put_rx_char(progdefaults.rx_lowercase ? tolower(c) : c, FTextBase::RECV, true);
@@ -530,8 +526,8 @@ int rtty::rx_process(const double *buf, int len)
 	double rotate;
 	double ferr = 0;
 
-	if (progdefaults.RTTY_BW != rtty_BW) {
-		rtty_BW = progdefaults.RTTY_BW;
+	if (rx_params_changed() && rxp.RTTY_BW != rtty_BW) {
+		rtty_BW = rxp.RTTY_BW;
 		bp_filt_lo = (shift/2.0 - rtty_BW/2.0) / samplerate;
 		if (bp_filt_lo < 0) bp_filt_lo = 0;
 		bp_filt_hi = (shift/2.0 + rtty_BW/2.0) / samplerate;
@@ -658,28 +654,6 @@ int rtty::rx_process(const double *buf, int len)
 // RTTY transmit
 //=====================================================================
 
-double rtty::nco(double freq)
-{
-	phaseacc += TWOPI * freq / samplerate;
-
-	if (phaseacc > M_PI)
-		phaseacc -= TWOPI;
-
-	return cos(phaseacc);
-}
-
-double rtty::FSKnco()
-{
-	FSKphaseacc += TWOPI * 1000 / samplerate;
-
-	if (FSKphaseacc > M_PI)
-
-		FSKphaseacc -= TWOPI;
-
-	return sin(FSKphaseacc);
-
-}
-
 void rtty::send_symbol(int symbol)
 {
 	double freq;
@@ -692,13 +666,13 @@ void rtty::send_symbol(int symbol)
 	else
 		freq = get_txfreq_woffset() - shift / 2.0;
 
-	for (int i = 0; i < symbollen; i++) {
-		outbuf[i] = nco(freq);
-		if (symbol)
-			FSKbuf[i] = FSKnco();
-		else
-			FSKbuf[i] = 0.0 * FSKnco();
-	}
+	txosc.set_freq(freq, samplerate);
+	txosc.fill_cos(outbuf, symbollen);
+	FSKosc.set_freq(1000, samplerate);
+	if (symbol)
+		FSKosc.fill_sin(FSKbuf, symbollen);
+	else
+		FSKosc.fill_zero(FSKbuf, symbollen);
 
 	if (progdefaults.PseudoFSK)
 		ModulateStereo(outbuf, FSKbuf, symbollen);
@@ -716,13 +690,13 @@ void rtty::send_stop()
 	else
 		freq = get_txfreq_woffset() + shift / 2.0;
 
-	for (int i = 0; i < stoplen; i++) {
-		outbuf[i] = nco(freq);
-		if (invert)
-			FSKbuf[i] = 0.0 * FSKnco();
-		else
-			FSKbuf[i] = FSKnco();
-	}
+	txosc.set_freq(freq, samplerate);
+	txosc.fill_cos(outbuf, stoplen);
+	FSKosc.set_freq(1000, samplerate);
+	if (invert)
+		FSKosc.fill_zero(FSKbuf, stoplen);
+	else
+		FSKosc.fill_sin(FSKbuf, stoplen);
 	if (progdefaults.PseudoFSK)
 		ModulateStereo(outbuf, FSKbuf, stoplen);
 	else
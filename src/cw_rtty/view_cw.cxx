@@ -0,0 +1,343 @@
+// ----------------------------------------------------------------------------
+// view_cw.cxx  --  multi-channel CW decoder for the signal browser
+//
+// Copyright (C) 2006-2010
+//		Dave Freese, W1HKJ
+//
+// This file is part of fldigi.
+//
+// Fldigi is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Fldigi is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with fldigi.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#include <config.h>
+
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#include "view_cw.h"
+#include "cw.h"
+#include "misc.h"
+#include "configuration.h"
+#include "status.h"
+#include "threads.h"
+#include "Viewer.h"
+#include "qrunner.h"
+
+using namespace std;
+
+// The whole passband goes through one short FFT every VCW_HOP samples; each
+// browser row watches the strongest bin in its own 100 Hz slot and runs the
+// same hysteresis detector and dot/dash speed tracker as the cw modem, with
+// timing counted in FFT frames instead of audio samples.
+
+view_cw::view_cw()
+{
+	fft = new Cfft(VCW_FFTLEN / 2);
+	fft->setWindow(FFT_HANNING);
+	pthread_mutex_init(&text_mutex, NULL);
+	restart();
+}
+
+view_cw::~view_cw()
+{
+	delete fft;
+	pthread_mutex_destroy(&text_mutex);
+}
+
+void view_cw::restart()
+{
+	for (int i = 0; i < VCW_FFTLEN; i++)
+		inbuf[i] = 0.0;
+	for (int i = 0; i < VCW_BINS; i++) {
+		power[i] = noise[i] = 0.0;
+		hits[i] = 0;
+		keyed[i] = false;
+	}
+	inptr = 0;
+	hopcnt = 0;
+	frame = 0;
+	squelch = pow(10, (progStatus.VIEWERsquelch + 6.0) / 10.0);
+
+	nchannels = progdefaults.VIEWERchannels;
+	if (nchannels > VCW_CHANNELS) nchannels = VCW_CHANNELS;
+
+	for (int ch = 0; ch < VCW_CHANNELS; ch++)
+		reset(ch);
+}
+
+void view_cw::reset(int ch)
+{
+	guard_lock lock(&text_mutex);
+
+	CW_CHANNEL &c = channel[ch];
+	c.state = CW_CHANNEL::IDLE;
+	c.bin = -1;
+	c.frequency = NULLFREQ;
+	c.mag = 0.0;
+	c.agc_peak = 0.0;
+	c.keydown = false;
+	c.after_tone = false;
+	c.space_sent = true;
+	c.start = c.end = frame;
+	c.last_element = 0;
+	c.threshold = 2 * DOT_MAGIC / progdefaults.CWspeed;
+	c.timeout = 0;
+	c.rep[0] = 0;
+	c.nrep = 0;
+	c.text.clear();
+}
+
+int view_cw::rx_process(const double *buf, int len)
+{
+	int nch = progdefaults.VIEWERchannels;
+	if (nch > VCW_CHANNELS) nch = VCW_CHANNELS;
+	if (nch != nchannels) {
+		for (int ch = nch; ch < nchannels; ch++)
+			reset(ch);
+		nchannels = nch;
+	}
+	squelch = pow(10, (progStatus.VIEWERsquelch + 6.0) / 10.0);
+
+	while (len-- > 0) {
+		inbuf[inptr] = *buf++;
+		if (++inptr == VCW_FFTLEN) inptr = 0;
+		if (++hopcnt == VCW_HOP) {
+			hopcnt = 0;
+			process_frame();
+		}
+	}
+	return 0;
+}
+
+void view_cw::process_frame()
+{
+// oldest sample first
+	int n = VCW_FFTLEN - inptr;
+	memcpy(fftbuf, inbuf + inptr, n * sizeof(double));
+	memcpy(fftbuf + n, inbuf, inptr * sizeof(double));
+	fft->rdft(fftbuf);
+
+	power[0] = 0.0;
+	for (int k = 1; k < VCW_BINS; k++)
+		power[k] = fftbuf[2*k] * fftbuf[2*k] + fftbuf[2*k+1] * fftbuf[2*k+1];
+
+	for (int k = 0; k < VCW_BINS; k++)
+		keyed[k] = false;
+	for (int ch = 0; ch < nchannels; ch++)
+		if (channel[ch].state == CW_CHANNEL::RCVNG && channel[ch].keydown)
+			for (int k = channel[ch].bin - 1; k <= channel[ch].bin + 1; k++)
+				keyed[k] = true;
+
+// noise floor per bin: a plain average to start with, then a slow average
+// of the power clipped at twice the floor, so that carriers barely lift it;
+// bins that a channel has keyed are left alone
+	for (int k = 0; k < VCW_BINS; k++) {
+		if (keyed[k]) continue;
+		if (frame < VCW_FRAMERATE / 4)
+			noise[k] = decayavg(noise[k], power[k] + 1e-20, frame + 1);
+		else
+			noise[k] = decayavg(noise[k], min(power[k], 2 * noise[k]) + 1e-20, 200);
+	}
+	frame++;
+
+	for (int k = 0; k < VCW_BINS; k++)
+		hits[k] = power[k] > squelch * noise[k] ? hits[k] + 1 : 0;
+
+	for (int ch = 0; ch < nchannels; ch++)
+		if (channel[ch].state == CW_CHANNEL::RCVNG)
+			decode(ch);
+
+	find_signals();
+}
+
+void view_cw::find_signals()
+{
+	int lowfreq = progdefaults.LowFreqCutoff;
+
+	for (int ch = 0; ch < nchannels; ch++) {
+		if (channel[ch].state != CW_CHANNEL::IDLE) continue;
+
+		double f1 = lowfreq + 100 * ch;
+		int kbest = -1;
+		double best = squelch;
+		for (int k = (int)ceil(f1 / VCW_BINWIDTH); k * VCW_BINWIDTH < f1 + 100; k++) {
+			if (k < 2 || k > VCW_BINS - 2) continue;
+// local maxima only, so one carrier does not show up in two slots
+			if (power[k] < power[k-1] || power[k] < power[k+1]) continue;
+			if (hits[k] < VCW_HITS) continue;
+			double snr = power[k] / noise[k];
+			if (snr <= best) continue;
+			if ((ch && abs(channel[ch-1].bin - k) <= 1) ||
+				(ch < nchannels - 1 && abs(channel[ch+1].bin - k) <= 1))
+				continue;
+			best = snr;
+			kbest = k;
+		}
+		if (kbest < 0) continue;
+
+		{
+			guard_lock lock(&text_mutex);
+			CW_CHANNEL &c = channel[ch];
+			c.state = CW_CHANNEL::RCVNG;
+			c.bin = kbest;
+			c.frequency = kbest * VCW_BINWIDTH;
+			c.mag = c.agc_peak = sqrt(power[kbest]);
+// the carrier has been up for VCW_HITS frames already: that is the first element
+			c.keydown = true;
+			c.start = c.end = frame - hits[kbest];
+			c.timeout = progdefaults.VIEWERtimeout * VCW_FRAMERATE;
+		}
+		REQ(&viewaddchr, ch, (int)channel[ch].frequency, 0, MODE_CW);
+	}
+}
+
+void view_cw::decode(int ch)
+{
+	CW_CHANNEL &c = channel[ch];
+// two frame average, much like the bit filter in the cw modem
+	double mag = sqrt(power[c.bin]);
+	double value = 0.5 * (mag + c.mag);
+	double p = value * value;
+	c.mag = mag;
+
+// fast attack, slow decay, as in cw::decode_stream
+	if (value > c.agc_peak)
+		c.agc_peak = decayavg(c.agc_peak, value, 10);
+	else
+		c.agc_peak = decayavg(c.agc_peak, value, 400);
+	if (c.agc_peak)
+		value /= c.agc_peak;
+	else
+		value = 0;
+
+	if (!c.keydown) {
+		if (value > progdefaults.CWupper && p > squelch * noise[c.bin]) {
+			c.keydown = true;
+			c.start = frame;
+			c.timeout = progdefaults.VIEWERtimeout * VCW_FRAMERATE;
+		} else {
+			long int silence = (long int)(frame - c.end) * VCW_FRAME_USEC;
+			long int dot = c.threshold / 2;
+			if (c.after_tone && silence >= 2 * dot) {
+				const char *s = rx_lookup(c.rep);
+				put_char(ch, s ? s : "*");
+				c.rep[0] = 0;
+				c.nrep = 0;
+				c.after_tone = false;
+				c.space_sent = false;
+			} else if (!c.after_tone && !c.space_sent && silence > 4 * dot) {
+				put_char(ch, " ");
+				c.space_sent = true;
+			}
+		}
+	} else if (value < progdefaults.CWlower) {
+		c.keydown = false;
+		long int element = (long int)(frame - c.start) * VCW_FRAME_USEC;
+// noise spike: ignore it and carry on timing the previous gap
+		if (element >= c.threshold / 4) {
+			if (c.last_element > 0) {
+				if (element > 2 * c.last_element && element < 4 * c.last_element)
+					update_tracking(ch, c.last_element, element);
+				if (c.last_element > 2 * element && c.last_element < 4 * element)
+					update_tracking(ch, element, c.last_element);
+			}
+			c.last_element = element;
+			if (c.nrep < VCW_REPLEN - 1) {
+				c.rep[c.nrep++] = element <= c.threshold ?
+					CW_DOT_REPRESENTATION : CW_DASH_REPRESENTATION;
+				c.rep[c.nrep] = 0;
+			} else {
+				c.rep[0] = 0;
+				c.nrep = 0;
+			}
+			c.after_tone = true;
+			c.end = frame;
+		}
+	}
+
+	timeout_check(ch);
+}
+
+// called on dot-dash and dash-dot pairs; every channel tracks its own speed
+// over the whole CWlowerlimit..CWupperlimit range
+void view_cw::update_tracking(int ch, long int dot, long int dash)
+{
+	long int t = (dot + dash) / 2;
+	if (t < 2 * DOT_MAGIC / progdefaults.CWupperlimit ||
+		t > 2 * DOT_MAGIC / progdefaults.CWlowerlimit)
+		return;
+	channel[ch].threshold = (long int)decayavg(channel[ch].threshold, t, 4);
+}
+
+void view_cw::put_char(int ch, const char *s)
+{
+	CW_CHANNEL &c = channel[ch];
+	guard_lock lock(&text_mutex);
+	for (; *s; s++) {
+		char out = progdefaults.rx_lowercase ? tolower(*s) : *s;
+		REQ(&viewaddchr, ch, (int)c.frequency, out, MODE_CW);
+		c.text += out;
+	}
+	if (c.text.length() > VCW_TEXTLEN)
+		c.text.erase(0, c.text.length() - VCW_TEXTLEN);
+}
+
+void view_cw::timeout_check(int ch)
+{
+	if (channel[ch].timeout && --channel[ch].timeout)
+		return;
+	reset(ch);
+	REQ(&viewclearchannel, ch);
+}
+
+void view_cw::clearch(int ch)
+{
+	if (ch < 0 || ch >= VCW_CHANNELS) return;
+	reset(ch);
+	REQ(&viewclearchannel, ch);
+}
+
+void view_cw::clear()
+{
+	for (int ch = 0; ch < VCW_CHANNELS; ch++)
+		reset(ch);
+}
+
+int view_cw::get_freq(int ch)
+{
+	if (ch < 0 || ch >= VCW_CHANNELS) return NULLFREQ;
+	return (int)channel[ch].frequency;
+}
+
+int view_cw::get_wpm(int ch)
+{
+	if (channel[ch].threshold <= 0) return 0;
+	return (int)(2 * DOT_MAGIC / channel[ch].threshold);
+}
+
+void view_cw::get_channels(vector<channel_info>& info)
+{
+	guard_lock lock(&text_mutex);
+	info.clear();
+	for (int ch = 0; ch < nchannels; ch++) {
+		if (channel[ch].state != CW_CHANNEL::RCVNG) continue;
+		channel_info ci;
+		ci.frequency = (int)channel[ch].frequency;
+		ci.wpm = get_wpm(ch);
+		ci.text = channel[ch].text;
+		info.push_back(ci);
+	}
+}
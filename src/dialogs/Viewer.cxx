@@ -43,6 +43,7 @@
 
 #include "psk_browser.h"
 #include "view_rtty.h"
+#include "view_cw.h"
 
 extern pskBrowser *mainViewer;
 
@@ -86,6 +87,7 @@ void initViewer()
 	}
 	if (pskviewer) pskviewer->clear();
 	if (rttyviewer) rttyviewer->clear();
+	if (cwviewer) cwviewer->clear();
 }
 
 void viewaddchr(int ch, int freq, char c, int md)
@@ -159,10 +161,11 @@ static void cb_btnClearViewer(Fl_Button*, void*) {
 		mainViewer->clear();
 	if (pskviewer) pskviewer->clear();
 	if (rttyviewer) rttyviewer->clear();
+	if (cwviewer) cwviewer->clear();
 }
 
 static void cb_brwsViewer(Fl_Hold_Browser*, void*) {
-	if (!pskviewer && !rttyviewer) return;
+	if (!pskviewer && !rttyviewer && !cwviewer) return;
 	int sel = brwsViewer->value();
 	if (sel == 0 || sel > progdefaults.VIEWERchannels)
 		return;
@@ -192,6 +195,7 @@ static void cb_brwsViewer(Fl_Hold_Browser*, void*) {
 		int ch = progdefaults.VIEWERascend ? progdefaults.VIEWERchannels - sel : sel - 1;
 		if (pskviewer) pskviewer->clearch(ch);
 		if (rttyviewer) rttyviewer->clearch(ch);
+		if (cwviewer) cwviewer->clearch(ch);
 		brwsViewer->deselect();
 		if (mainViewer) mainViewer->deselect();
 		}
@@ -357,6 +361,22 @@ void viewer_paste_freq(int freq)
 			}
 		}
 	}
+	if (cwviewer) {
+		for (int i = 0; i < progdefaults.VIEWERchannels; i++) {
+			int ftest = cwviewer->get_freq(i);
+			if (ftest == NULLFREQ) continue;
+			if (fabs(ftest - freq) <= 50) {
+				if (progdefaults.VIEWERascend)
+					i = (progdefaults.VIEWERchannels - i);
+				else i++;
+				if (mainViewer)
+					mainViewer->select(i);
+				if (brwsViewer)
+					brwsViewer->select(i);
+				return;
+			}
+		}
+	}
 }
 
 
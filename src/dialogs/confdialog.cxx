@@ -1282,6 +1282,7 @@ progdefaults.changed = true;
 if (o->value()) {
   progdefaults.sig_on_right_channel = false;
   chkAudioStereoOut->value(0);
+  updateTxRoute();
   progdefaults.PTTrightchannel = false;
   btnPTTrightchannel->value(0);
   if (progdefaults.mono_audio) {
@@ -1862,6 +1863,7 @@ progdefaults.changed = true;
 if (o->value()) {
   progdefaults.sig_on_right_channel = false;
   chkAudioStereoOut->value(0);
+  updateTxRoute();
   progdefaults.PTTrightchannel = false;
   btnPTTrightchannel->value(0);
   if (progdefaults.mono_audio) {
@@ -2053,6 +2055,7 @@ if (o->value()) {
   chkPseudoFSK->value(0);
   progdefaults.sig_on_right_channel = false;
   chkAudioStereoOut->value(0);
+  updateTxRoute();
   if (progdefaults.mono_audio) {
     progdefaults.mono_audio = false;
     chkForceMono->value(0);
@@ -2798,6 +2801,7 @@ Fl_Check_Button *chkAudioStereoOut=(Fl_Check_Button *)0;
 static void cb_chkAudioStereoOut(Fl_Check_Button* o, void*) {
   progdefaults.sig_on_right_channel = o->value();
 progdefaults.changed = true;
+updateTxRoute();
 if (o->value()) {
   progdefaults.QSK = false;
   btnQSK->value(0);
@@ -2821,6 +2825,7 @@ Fl_Check_Button *chkReverseAudio=(Fl_Check_Button *)0;
 static void cb_chkReverseAudio(Fl_Check_Button* o, void*) {
   progdefaults.ReverseAudio = o->value();
 progdefaults.changed = true;
+updateTxRoute();
   if (progdefaults.mono_audio) {
     progdefaults.mono_audio = false;
     chkForceMono->value(0);
@@ -2843,6 +2848,7 @@ if (o->value()) {
   chkPseudoFSK2->value(0);
   progdefaults.sig_on_right_channel = false;
   chkAudioStereoOut->value(0);
+  updateTxRoute();
   if (progdefaults.mono_audio) {
     progdefaults.mono_audio = false;
     chkForceMono->value(0);
@@ -2860,6 +2866,7 @@ progdefaults.changed = true;
 if (o->value()) {
   progdefaults.sig_on_right_channel = false;
   chkAudioStereoOut->value(0);
+  updateTxRoute();
   progdefaults.PTTrightchannel = false;
   btnPTTrightchannel->value(0);
   btnPTTrightchannel2->value(0);
@@ -2880,6 +2887,7 @@ progdefaults.changed = true;
 if (o->value()) {
   progdefaults.sig_on_right_channel = false;
   chkAudioStereoOut->value(0);
+  updateTxRoute();
   progdefaults.PTTrightchannel = false;
   btnPTTrightchannel->value(0);
   btnPTTrightchannel2->value(0);
@@ -102,6 +102,7 @@
 #include "navtex.h"
 #include "mt63.h"
 #include "view_rtty.h"
+#include "view_cw.h"
 #include "olivia.h"
 #include "contestia.h"
 #include "thor.h"
@@ -169,6 +170,7 @@
 
 #include <iostream>
 #include "dl_fldigi/dl_fldigi.h"
+#include "dl_fldigi/extract.h"
 #include "dl_fldigi/flights.h"
 #include "dl_fldigi/hbtint.h"
 #include "dl_fldigi/update.h"
@@ -2556,6 +2558,7 @@ void cb_btnClearMViewer(Fl_Widget *w, void *d)
 	mainViewer->clear();
 	if (pskviewer) pskviewer->clear();
 	if (rttyviewer) rttyviewer->clear();
+	if (cwviewer) cwviewer->clear();
 }
 
 int default_handler(int event)
@@ -3936,7 +3939,7 @@ static void cb_cntTxLevel(Fl_Counter2* o, void*) {
 }
 
 static void cb_mainViewer(Fl_Hold_Browser*, void*) {
-	if (!pskviewer && !rttyviewer) return;
+	if (!pskviewer && !rttyviewer && !cwviewer) return;
 	int sel = mainViewer->value();
 	if (sel == 0 || sel > progdefaults.VIEWERchannels)
 		return;
@@ -3965,6 +3968,7 @@ static void cb_mainViewer(Fl_Hold_Browser*, void*) {
 		int ch = progdefaults.VIEWERascend ? progdefaults.VIEWERchannels - sel : sel - 1;
 		if (pskviewer) pskviewer->clearch(ch);
 		if (rttyviewer) rttyviewer->clearch(ch);
+		if (cwviewer) cwviewer->clearch(ch);
 		mainViewer->deselect();
 		if (brwsViewer) brwsViewer->deselect();
 		break;
@@ -6380,6 +6384,146 @@ void put_Bandwidth(int bandwidth)
 	wf->Bandwidth ((int)bandwidth);
 }
 
+// UI update coalescing.  Worker threads store the latest status text, signal
+// metric and widget redraws in these slots, and ui_update_cb applies whatever
+// changed UI_UPDATE_RATE times per second on the main thread.  A burst of
+// per-block updates from the trx thread then costs one widget update and no
+// qrunner request, and the writer never waits for the main thread.
+
+#define UI_UPDATE_RATE 25
+#define UI_MAX_REDRAW 8
+
+enum { UI_STATUS, UI_STATUS1, UI_STATUS2, UI_NUM_STATUS };
+
+struct ui_status_slot {
+	Fl_Box** box;
+	bool dirty;
+	char msg[64];
+	double timeout;
+	status_timeout action;
+};
+
+static struct {
+	volatile int lock;
+	ui_status_slot status[UI_NUM_STATUS];
+	bool metric_dirty;
+	double metric;
+	Fl_Widget* redraw[UI_MAX_REDRAW];
+	bool redraw_dirty[UI_MAX_REDRAW];
+	unsigned long requests, frames;
+} ui_slots = { 0, { { &StatusBar }, { &Status1 }, { &Status2 } } };
+
+static void put_status_msg(Fl_Box* status, const char* msg, double timeout, status_timeout action);
+static void callback_set_metric(double metric);
+
+// The slots are held for a few dozen bytes' copy at most
+static inline void ui_slots_lock(void)
+{
+	while (__sync_lock_test_and_set(&ui_slots.lock, 1))
+		while (ui_slots.lock)
+			;
+}
+
+static inline void ui_slots_unlock(void)
+{
+	__sync_lock_release(&ui_slots.lock);
+}
+
+static void ui_set_status(int which, const char* msg, double timeout, status_timeout action)
+{
+	ui_status_slot& s = ui_slots.status[which];
+
+	ui_slots_lock();
+	strncpy(s.msg, msg, sizeof(s.msg));
+	s.msg[sizeof(s.msg) - 1] = '\0';
+	s.timeout = timeout;
+	s.action = action;
+	s.dirty = true;
+	ui_slots.requests++;
+	ui_slots_unlock();
+}
+
+// Coalesced w->redraw()
+void ui_redraw(Fl_Widget* w)
+{
+	ui_slots_lock();
+	ui_slots.requests++;
+	for (int i = 0; i < UI_MAX_REDRAW; i++) {
+		if (!ui_slots.redraw[i])
+			ui_slots.redraw[i] = w;
+		if (ui_slots.redraw[i] == w) {
+			ui_slots.redraw_dirty[i] = true;
+			ui_slots_unlock();
+			return;
+		}
+	}
+	ui_slots_unlock();
+
+	REQ_DROP(&Fl_Widget::redraw, w);
+}
+
+static void ui_update_cb(void*)
+{
+	static char msg[UI_NUM_STATUS][sizeof(ui_slots.status[0].msg)];
+	ui_status_slot status[UI_NUM_STATUS];
+	Fl_Widget* redraw[UI_MAX_REDRAW];
+	bool metric_dirty;
+	double metric = 0.0;
+	int nredraw = 0;
+
+	ui_slots_lock();
+	for (int i = 0; i < UI_NUM_STATUS; i++) {
+		status[i] = ui_slots.status[i];
+		ui_slots.status[i].dirty = false;
+	}
+	if ((metric_dirty = ui_slots.metric_dirty)) {
+		metric = ui_slots.metric;
+		ui_slots.metric_dirty = false;
+	}
+	for (int i = 0; i < UI_MAX_REDRAW; i++) {
+		if (ui_slots.redraw_dirty[i]) {
+			redraw[nredraw++] = ui_slots.redraw[i];
+			ui_slots.redraw_dirty[i] = false;
+		}
+	}
+	ui_slots_unlock();
+
+	bool changed = metric_dirty || nredraw;
+	for (int i = 0; i < UI_NUM_STATUS; i++) {
+		if (!status[i].dirty)
+			continue;
+		// the label is not copied by the widget
+		memcpy(msg[i], status[i].msg, sizeof(msg[i]));
+		put_status_msg(*status[i].box, msg[i], status[i].timeout, status[i].action);
+		changed = true;
+	}
+	if (metric_dirty)
+		callback_set_metric(metric);
+	for (int i = 0; i < nredraw; i++)
+		redraw[i]->redraw();
+
+	if (changed)
+		ui_slots.frames++;
+
+	static int ticks = 0;
+	if (++ticks == 60 * UI_UPDATE_RATE) {
+		LOG_DEBUG("%lu UI updates in %lu frames in the last minute",
+			  ui_slots.requests, ui_slots.frames);
+		ui_slots_lock();
+		ui_slots.requests = 0;
+		ui_slots_unlock();
+		ui_slots.frames = 0;
+		ticks = 0;
+	}
+
+	Fl::repeat_timeout(1.0 / UI_UPDATE_RATE, ui_update_cb);
+}
+
+void start_ui_updates(void)
+{
+	Fl::add_timeout(1.0 / UI_UPDATE_RATE, ui_update_cb);
+}
+
 static void callback_set_metric(double metric)
 {
 	pgrsSquelch->value(metric);
@@ -6394,10 +6538,11 @@ static void callback_set_metric(double metric)
 
 void global_display_metric(double metric)
 {
-	FL_LOCK_D();
-	REQ_DROP(callback_set_metric, metric);
-	FL_UNLOCK_D();
-	FL_AWAKE_D();
+	ui_slots_lock();
+	ui_slots.metric = metric;
+	ui_slots.metric_dirty = true;
+	ui_slots.requests++;
+	ui_slots_unlock();
 }
 
 void put_cwRcvWPM(double wpm)
@@ -6662,7 +6807,7 @@ void put_rx_char(unsigned int data, int style, bool extracted)
 
     if (!extracted)
     {
-        dl_fldigi::hbtint::extrmgr->push(data);
+        dl_fldigi::extract::push(data);
     }
 }
 
@@ -6730,11 +6875,7 @@ static void put_status_msg(Fl_Box* status, const char* msg, double timeout, stat
 
 void put_status(const char *msg, double timeout, status_timeout action)
 {
-	static char m[50];
-	strncpy(m, msg, sizeof(m));
-	m[sizeof(m) - 1] = '\0';
-
-	REQ(put_status_msg, StatusBar, m, timeout, action);
+	ui_set_status(UI_STATUS, msg, timeout, action);
 }
 
 void put_status_safe(const char *msg, double timeout, status_timeout action)
@@ -6751,24 +6892,16 @@ void put_status_safe(const char *msg, double timeout, status_timeout action)
 
 void put_Status2(const char *msg, double timeout, status_timeout action)
 {
-	static char m[60];
-	strncpy(m, msg, sizeof(m));
-	m[sizeof(m) - 1] = '\0';
-
 	info2msg = msg;
 
-	REQ(put_status_msg, Status2, m, timeout, action);
+	ui_set_status(UI_STATUS2, msg, timeout, action);
 }
 
 void put_Status1(const char *msg, double timeout, status_timeout action)
 {
-	static char m[60];
-	strncpy(m, msg, sizeof(m));
-	m[sizeof(m) - 1] = '\0';
-
 	info1msg = msg;
 	if (progStatus.NO_RIGLOG) return;
-	REQ(put_status_msg, Status1, m, timeout, action);
+	ui_set_status(UI_STATUS1, msg, timeout, action);
 }
 
 
@@ -7176,6 +7309,13 @@ void resetSoundCard()
         enableMixer(true);
 }
 
+// Apply the output channel options to the open sound card stream
+void updateTxRoute()
+{
+	if (scard)
+		scard->tx_route_update();
+}
+
 void setReverse(int rev) {
 	active_modem->set_reverse(rev);
 }
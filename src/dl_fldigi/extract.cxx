@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2012 Daniel Richman
+ * License: GNU GPL 3
+ *
+ * extract.cxx: UKHAS sentence scanner, between the modems and habitat
+ */
+
+#include "dl_fldigi/extract.h"
+
+#include <string.h>
+
+#include <FL/Fl.H>
+
+#include "debug.h"
+#include "util.h"
+
+#include "habitat/Extractor.h"
+#include "dl_fldigi/hbtint.h"
+
+namespace dl_fldigi {
+namespace extract {
+
+/* CRC16-CCITT (0x1021, initial value 0xFFFF), as used by UKHAS */
+static unsigned short crc_table[256];
+
+static struct crc_table_init
+{
+    crc_table_init()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            unsigned short crc = i << 8;
+            for (int j = 0; j < 8; j++)
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+            crc_table[i] = crc;
+        }
+    }
+} crc_table_init_;
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+bool scanner::push(char c, bool baudot)
+{
+    if (c == '\r')
+        c = '\n';
+
+    if (c == '$' && last == '$')
+    {
+        /* Start (or restart, if we were in garbage) a sentence */
+        cur.text[0] = cur.text[1] = '$';
+        cur.length = 2;
+        cur.field[0] = 2;
+        cur.fields = 1;
+        cur.baudot = baudot;
+        sum_xor = 0;
+        sum_crc = 0xFFFF;
+        star = -1;
+        active = true;
+        last = 0;
+        return false;
+    }
+
+    last = c;
+
+    /* Letters/figures shifts and the like */
+    if (!active || c == '\0')
+        return false;
+
+    if (c == '\n')
+    {
+        active = false;
+        return finish();
+    }
+
+    if ((unsigned char) c < 0x20 || (unsigned char) c > 0x7E ||
+        cur.length >= max_length - 2)
+    {
+        abandon();
+        return false;
+    }
+
+    cur.text[cur.length++] = c;
+
+    if (star == -1)
+    {
+        if (c == '*')
+        {
+            star = cur.length - 1;
+            return false;
+        }
+
+        sum_xor ^= c;
+        sum_crc = (sum_crc << 8) ^ crc_table[(sum_crc >> 8) ^ (unsigned char) c];
+
+        if (c == ',' && cur.fields < max_fields)
+            cur.field[cur.fields++] = cur.length;
+    }
+    else if (hex_value(c) == -1 || cur.length - star > 5)
+    {
+        abandon();
+    }
+
+    return false;
+}
+
+bool scanner::finish()
+{
+    cur.body_end = star == -1 ? cur.length : star;
+    cur.text[cur.length++] = '\n';
+    cur.text[cur.length] = '\0';
+
+    int digits = star == -1 ? -1 : cur.length - 2 - star;
+
+    unsigned int value = 0;
+    for (int i = 0; i < digits; i++)
+        value = (value << 4) | hex_value(cur.text[star + 1 + i]);
+
+    if (digits == 2 && value == sum_xor)
+        cur.checksum = CHECKSUM_XOR;
+    else if (digits == 4 && value == sum_crc)
+        cur.checksum = CHECKSUM_CRC16;
+    else if (digits == -1 && cur.baudot)
+        /* ITA2 has no '*': pass it on, habitat has the last word */
+        cur.checksum = CHECKSUM_NONE;
+    else
+    {
+        rejected++;
+        return false;
+    }
+
+    return true;
+}
+
+void scanner::abandon()
+{
+    active = false;
+    rejected++;
+}
+
+/* Bytes were lost: the current sentence can't pass its checksum */
+void scanner::skipped()
+{
+    if (active)
+        abandon();
+}
+
+/* Single producer (the trx thread), single consumer (the main thread) */
+static const unsigned int queue_size = 16;
+static sentence queue[queue_size];
+static volatile unsigned int queue_head, queue_tail;
+static volatile int deliver_pending;
+static volatile unsigned long queue_dropped;
+
+static scanner rx_scanner;
+
+static void deliver(void *)
+{
+    __sync_lock_release(&deliver_pending);
+    __sync_synchronize();
+
+    static unsigned long dropped = 0;
+    if (dropped != queue_dropped)
+    {
+        dropped = queue_dropped;
+        LOG_WARN("sentence queue full, %lu dropped", dropped);
+    }
+
+    while (queue_tail != queue_head)
+    {
+        read_memory_barrier();
+        const sentence &s = queue[queue_tail % queue_size];
+
+        LOG_DEBUG("sentence from %.*s (%d fields, checksum %d)",
+                  (int) s.field_length(0), s.text + s.field[0],
+                  s.fields, s.checksum);
+
+        if (hbtint::extrmgr)
+        {
+            for (int i = 0; i < s.length; i++)
+            {
+                if (s.baudot)
+                    hbtint::extrmgr->push(s.text[i], habitat::PUSH_BAUDOT_HACK);
+                else
+                    hbtint::extrmgr->push(s.text[i]);
+            }
+        }
+
+        write_memory_barrier();
+        queue_tail++;
+    }
+}
+
+void push(unsigned int c, bool baudot)
+{
+    if (c > 0xFF || !rx_scanner.push(c, baudot))
+        return;
+
+    if (queue_head - queue_tail == queue_size)
+    {
+        queue_dropped++;
+        return;
+    }
+
+    sentence &s = queue[queue_head % queue_size];
+    memcpy(&s, &rx_scanner.current(), sizeof(s));
+
+    write_memory_barrier();
+    queue_head++;
+
+    if (__sync_lock_test_and_set(&deliver_pending, 1) == 0)
+        Fl::awake(deliver, 0);
+}
+
+void skipped(int n)
+{
+    if (n)
+        rx_scanner.skipped();
+}
+
+} /* namespace extract */
+} /* namespace dl_fldigi */
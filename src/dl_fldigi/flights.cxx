@@ -12,7 +12,14 @@
 #include <fstream>
 #include <sstream>
 #include <set>
+#include <map>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef __MINGW32__
+#include <sys/mman.h>
+#endif
 
 #include "main.h"
 #include "debug.h"
@@ -34,6 +41,12 @@ bool downloaded_flights_once, downloaded_payloads_once;
 
 static string flight_cache_file, payload_cache_file;
 static vector<Json::Value> flight_docs, payload_docs;
+static CacheThread *cache_thread;
+
+/* Rebuilt by populate_{flights,payloads}: doc index by _id, and the
+ * squashed text of each payload_browser row for payload_search */
+static map<string, int> flight_index, payload_index;
+static vector<string> payload_search_keys;
 
 /* These pointers just point at some part of the heap allocated by something
  * in either the flight_docs vector (if cur_heap == TRACKING_FLIGHT) or 
@@ -58,8 +71,13 @@ static void write_cache_file(const string &name,
 /* Note: these functions, in the menus they populate, store the index of the
  * Json::Value in the array it's contained in as the userdata of the item,
  * cast (int) -> (void *) */
+static void cache_loaded(void *what);
+static bool same_ids(const vector<Json::Value> &a,
+                     const vector<Json::Value> &b);
 static void populate_flights();
 static void populate_payloads();
+static bool payload_row(const Json::Value &root, string &id, string &item);
+static void update_payload(int index, const Json::Value &doc);
 
 static void select_flight_payload(int index);
 static void do_select_payload(const Json::Value &payload);
@@ -112,8 +130,14 @@ void cleanup()
 {
     /* called with Fl lock acquired */
 
+    while (cache_thread)
+        Fl::wait();
+
     flight_docs.clear();
     payload_docs.clear();
+    flight_index.clear();
+    payload_index.clear();
+    payload_search_keys.clear();
     cur_flight = NULL;
     cur_payload = NULL;
     cur_transmission = NULL;
@@ -127,20 +151,64 @@ void load_cache()
     /* resets everything */
     select_flight(-1);
 
-    /* called with Fl lock acquired */
+    /* called with Fl lock acquired. The files are parsed in the
+     * background, and shown by cache_loaded */
 
-    load_cache_file(flight_cache_file, flight_docs);
-    load_cache_file(payload_cache_file, payload_docs);
+    if (cache_thread)
+        return;
 
-    populate_flights();
-    populate_payloads();
+    cache_thread = new CacheThread();
+    cache_thread->start();
+}
+
+void *CacheThread::run()
+{
+    load_cache_file(flight_cache_file, flights);
+    load_cache_file(payload_cache_file, payloads);
+    Fl::awake(cache_loaded, this);
+    return NULL;
+}
+
+/* invoked via Fl::awake; so we have the main Fl lock */
+static void cache_loaded(void *what)
+{
+    if (what != cache_thread)
+    {
+        LOG_ERROR("unknown thread");
+        return;
+    }
+
+    cache_thread->join();
+
+    /* Docs downloaded in the meantime are newer than the cache */
+    if (!downloaded_flights_once)
+    {
+        flight_docs.swap(cache_thread->flights);
+        populate_flights();
+    }
+
+    if (!downloaded_payloads_once)
+    {
+        payload_docs.swap(cache_thread->payloads);
+        populate_payloads();
+    }
+
+    delete cache_thread;
+    cache_thread = 0;
 }
 
 void new_flight_docs(const vector<Json::Value> &new_flights)
 {
     Fl_AutoLock lock;
-    flight_docs = new_flights;
     downloaded_flights_once = true;
+
+    if (flight_docs == new_flights)
+    {
+        LOG_DEBUG("flight docs unchanged");
+        return;
+    }
+
+    flight_docs = new_flights;
     write_cache_file(flight_cache_file, flight_docs);
     populate_flights();
 }
@@ -148,18 +216,38 @@ void new_flight_docs(const vector<Json::Value> &new_flights)
 void new_payload_docs(const vector<Json::Value> &new_payloads)
 {
     Fl_AutoLock lock;
-    payload_docs = new_payloads;
     downloaded_payloads_once = true;
-    write_cache_file(payload_cache_file, payload_docs);
-    populate_payloads();
+
+    if (!same_ids(payload_docs, new_payloads))
+    {
+        payload_docs = new_payloads;
+        write_cache_file(payload_cache_file, payload_docs);
+        populate_payloads();
+        return;
+    }
+
+    /* Same docs in the same order: only touch the rows that changed */
+    bool changed = false;
+
+    for (int i = 0; i < int(new_payloads.size()); i++)
+    {
+        if (payload_docs[i] == new_payloads[i])
+            continue;
+
+        update_payload(i, new_payloads[i]);
+        changed = true;
+    }
+
+    if (changed)
+        write_cache_file(payload_cache_file, payload_docs);
+    else
+        LOG_DEBUG("payload docs unchanged");
 }
 
 void payload_search(bool next)
 {
-    /* Searching the payload_browser rather than looking through our JSON docs?
-     * Well: it's easier in several ways, and quicker. We've already extracted
-     * the important strings in populate_flights and filtered for testing
-     * flights; that would have to be duplicated. */
+    /* Search the text of the payload_browser rows, squashed once by
+     * populate_payloads rather than on every keystroke. */
 
     Fl_AutoLock lock;
 
@@ -167,7 +255,7 @@ void payload_search(bool next)
     if (!search.size())
         return;
 
-    int n = payload_browser->size();
+    int n = payload_search_keys.size();
 
     if (!n)
         return;
@@ -179,9 +267,7 @@ void payload_search(bool next)
 
     do
     {
-        const string line(squash_string(payload_browser->text(i)));
-
-        if (line.find(search) != string::npos)
+        if (payload_search_keys[i - 1].find(search) != string::npos)
         {
             payload_browser->value(i);
             select_payload(i - 1);
@@ -386,38 +472,77 @@ void auto_switchmode()
     auto_configure();
 }
 
+/* Runs in the cache loading thread, so must not touch the UI */
 static void load_cache_file(const string &name, vector<Json::Value> &target)
 {
-    ifstream cf(name.c_str());
+    int fd = open(name.c_str(), O_RDONLY);
+    struct stat st;
 
-    if (cf.fail())
+    if (fd == -1 || fstat(fd, &st) == -1)
     {
+        Fl_AutoLock lock;
         LOG_DEBUG("Failed to open cache file %s", name.c_str());
+        if (fd != -1)
+            close(fd);
         return;
     }
 
     target.clear();
 
-    while (cf.good())
+    size_t size = st.st_size;
+    const char *data = NULL;
+    bool failed = false;
+
+    if (size)
     {
-        string line;
-        getline(cf, line, '\n');
+#ifndef __MINGW32__
+        void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+            data = (const char *) map;
+#else
+        char *buf = new char[size];
+        if (read(fd, buf, size) == (ssize_t) size)
+            data = buf;
+        else
+            delete [] buf;
+#endif
+        failed = (data == NULL);
+    }
 
-        char discard;
-        while (cf.good() && cf.peek() == '\n')
-            cf.get(discard);
+    /* One doc per line; parse each straight out of the mapping */
+    Json::Reader reader;
+    const char *line = data, *end = data + size;
 
-        Json::Reader reader;
-        Json::Value root;
-        if (!reader.parse(line, root, false))
-            break;
+    while (!failed && line < end)
+    {
+        const char *nl = (const char *) memchr(line, '\n', end - line);
+        if (!nl)
+            nl = end;
 
-        target.push_back(root);
+        if (nl != line)
+        {
+            Json::Value root;
+            if (!reader.parse(line, nl, root, false))
+                failed = true;
+            else
+                target.push_back(root);
+        }
+
+        line = nl + 1;
     }
 
-    bool failed = cf.fail() || !cf.eof();
+    if (data)
+    {
+#ifndef __MINGW32__
+        munmap((void *) data, size);
+#else
+        delete [] data;
+#endif
+    }
 
-    cf.close();
+    close(fd);
+
+    Fl_AutoLock lock;
 
     if (failed)
     {
@@ -470,6 +595,7 @@ static void populate_flights()
     }
 
     flight_browser->clear();
+    flight_index.clear();
 
     if (cur_heap == TRACKING_FLIGHT)
         select_flight(-1);
@@ -519,15 +645,20 @@ static void populate_flights()
         string browser_item = flight_browser_item(name, date, callsign_list);
         flight_browser->add(browser_item.c_str(), NULL);
 
-        if (root_ok &&
-            progdefaults.tracking_type == TRACKING_FLIGHT &&
-            progdefaults.tracking_doc == id)
-        {
-            if (hab_ui_exists)
-                habFlight->value(i);
-            flight_browser->value(i + 1);
-            select_flight(i);
-        }
+        if (root_ok)
+            flight_index.insert(make_pair(id, i));
+    }
+
+    map<string, int>::const_iterator it =
+        flight_index.find(progdefaults.tracking_doc);
+
+    if (progdefaults.tracking_type == TRACKING_FLIGHT &&
+        it != flight_index.end())
+    {
+        if (hab_ui_exists)
+            habFlight->value(it->second);
+        flight_browser->value(it->second + 1);
+        select_flight(it->second);
     }
 }
 
@@ -538,46 +669,106 @@ static void populate_payloads()
     LOG_DEBUG("populating payloads (%zi)", payload_docs.size());
 
     payload_browser->clear();
+    payload_index.clear();
+    payload_search_keys.clear();
+    payload_search_first = 1;
 
     if (cur_heap == TRACKING_PAYLOAD)
         select_payload(-1);
 
     for (int i = 0; i < int(payload_docs.size()); i++)
     {
-        const Json::Value &root = payload_docs[i];
+        string id, browser_item;
 
-        string id, name, callsign_list, description;
-        bool root_ok;
+        if (payload_row(payload_docs[i], id, browser_item))
+            payload_index.insert(make_pair(id, i));
 
-        if (root.isObject() && root.size() &&
-            root["_id"].isString() && root["name"].isString())
-        {
-            id = root["_id"].asString();
-            name = root["name"].asString();
-            callsign_list = payload_callsign_list(root);
+        payload_browser->add(browser_item.c_str(), NULL);
+        payload_search_keys.push_back(squash_string(browser_item.c_str()));
+    }
 
-            if (root["metadata"]["description"].isString())
-                description = root["metadata"]["description"].asString();
-        }
+    map<string, int>::const_iterator it =
+        payload_index.find(progdefaults.tracking_doc);
 
-        if (!id.size() || !name.size())
-        {
-            LOG_WARN("invalid payload doc");
-            root_ok = false;
-        }
+    if (progdefaults.tracking_type == TRACKING_PAYLOAD &&
+        it != payload_index.end())
+    {
+        payload_browser->value(it->second + 1);
+        select_payload(it->second);
+    }
+}
 
-        string browser_item = payload_browser_item(name, callsign_list,
-                                                   description);
-        payload_browser->add(browser_item.c_str(), NULL);
+/* Returns false (and a placeholder item) if the doc is invalid */
+static bool payload_row(const Json::Value &root, string &id, string &item)
+{
+    string name, callsign_list, description;
 
-        if (root_ok &&
-            progdefaults.tracking_type == TRACKING_PAYLOAD &&
-            progdefaults.tracking_doc == id)
-        {
-            payload_browser->value(i + 1);
-            select_payload(i);
-        }
+    if (root.isObject() && root.size() &&
+        root["_id"].isString() && root["name"].isString())
+    {
+        id = root["_id"].asString();
+        name = root["name"].asString();
+        callsign_list = payload_callsign_list(root);
+
+        if (root["metadata"]["description"].isString())
+            description = root["metadata"]["description"].asString();
+    }
+
+    item = payload_browser_item(name, callsign_list, description);
+
+    if (!id.size() || !name.size())
+    {
+        LOG_WARN("invalid payload doc");
+        return false;
+    }
+
+    return true;
+}
+
+/* Replace payload_docs[index], which has the same _id as doc */
+static void update_payload(int index, const Json::Value &doc)
+{
+    /* The extractor manager and the UI point into the doc being replaced */
+    bool tracked = (cur_heap == TRACKING_PAYLOAD &&
+                    cur_payload == &payload_docs[index]);
+
+    if (tracked)
+        select_payload(-1);
+
+    payload_docs[index] = doc;
+
+    string id, browser_item;
+    payload_row(doc, id, browser_item);
+
+    payload_browser->text(index + 1, browser_item.c_str());
+    payload_search_keys[index] = squash_string(browser_item.c_str());
+
+    if (tracked)
+    {
+        payload_browser->value(index + 1);
+        select_payload(index);
+    }
+}
+
+/* True if both lists hold the same docs (by _id), in the same order */
+static bool same_ids(const vector<Json::Value> &a,
+                     const vector<Json::Value> &b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (!a[i].isObject() || !b[i].isObject())
+            return false;
+
+        const Json::Value &x = a[i]["_id"], &y = b[i]["_id"];
+
+        if (!x.isString() || !y.isString() || x.asString() != y.asString())
+            return false;
     }
+
+    return true;
 }
 
 static void select_flight_payload(int index)
@@ -12,6 +12,9 @@
 #include <signal.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 
@@ -29,6 +32,7 @@
 #include "confdialog.h"
 #include "debug.h"
 #include "fl_digi.h"
+#include "util.h"
 
 #include "jsoncpp.h"
 
@@ -202,193 +206,305 @@ void GPSThread::log(const string &message)
     LOG_DEBUG("hbtGPS %s", message.c_str());
 }
 
-static bool check_gpgga(const vector<string> &parts)
+/* The latest fix, published by the GPS thread without taking any lock: a
+ * sequence lock whose counter is odd while the fix is being written. The
+ * main thread is woken at most once per fix with Fl::awake, so a burst of
+ * sentences collapses into a single widget update. */
+struct gps_fix
 {
-    if (parts.size() < 7)
-        return false;
+    char time_str[9];
+    double latitude, longitude, altitude;
 
-    if (parts[0] != "$GPGGA")
-        return false;
+    /* Mean position over the last upload period; upload_seq is bumped
+     * each time it is due for upload */
+    double up_latitude, up_longitude, up_altitude;
+    unsigned long upload_seq;
+};
 
-    /* Fix quality field */
-    if (parts[6] == "0")
-        return false;
+static gps_fix latest_fix;
+static volatile unsigned int fix_seq;
+static volatile int fix_pending;
 
-    for (int i = 1; i < 7; i++)
-        if (!parts[i].size())
-            return false;
+static void read_fix(gps_fix &fix)
+{
+    unsigned int seq;
 
-    return true;
+    do
+    {
+        while ((seq = fix_seq) & 1)
+            ;
+        read_memory_barrier();
+        fix = latest_fix;
+        read_memory_barrier();
+    }
+    while (seq != fix_seq);
 }
 
-static void split_nmea(const string &data, vector<string> &parts)
+static void gps_fix_show(void *)
 {
-    size_t a = 0, b = 0;
+    static unsigned long last_upload_seq = 0;
 
-    while (b != string::npos)
-    {
-        string part;
-        b = data.find_first_of(",*", a);
+    __sync_lock_release(&fix_pending);
+    __sync_synchronize();
 
-        if (b == string::npos)
-            part = data.substr(a);
-        else
-            part = data.substr(a, b - a);
+    gps_fix fix;
+    read_fix(fix);
 
-        parts.push_back(part);
-        a = b + 1;
-    }
-}
+    ostringstream lat_tmp, lon_tmp, alt_tmp;
+    lat_tmp << fix.latitude;
+    lon_tmp << fix.longitude;
+    alt_tmp << fix.altitude;
 
-static string parse_hms(const string &part)
-{
-    ostringstream temp;
-    temp << part.substr(0, 2) << ':'
-        << part.substr(2, 2) << ':'
-        << part.substr(4, 2);
-    if (temp.str().size() != 8)
-        throw runtime_error("bad NMEA time");
-    return temp.str();
-}
+    gps_pos_time->value(fix.time_str);
+    gps_pos_lat->value(lat_tmp.str().c_str());
+    gps_pos_lon->value(lon_tmp.str().c_str());
+    gps_pos_altitude->value(alt_tmp.str().c_str());
 
-static double parse_ddm(string part, const string &dirpart)
-{
-    double degrees, mins;
-    size_t pos = part.find('.');
-    if (pos == string::npos || pos < 3)
-        throw runtime_error("Bad DDM");
+    gps_pos_save->activate();
 
-    /* Split degrees and minutes parts */
-    part.insert(pos - 2, " ");
+    if (fix.upload_seq == last_upload_seq)
+        return;
+    last_upload_seq = fix.upload_seq;
+
+    if (location::current_location_mode != location::LOC_GPS)
+        return;
 
-    istringstream tmp(part);
-    tmp.exceptions(istringstream::failbit | istringstream::badbit);
+    location::listener_valid = true;
+    location::listener_latitude = fix.up_latitude;
+    location::listener_longitude = fix.up_longitude;
+    location::listener_altitude = fix.up_altitude;
+    location::update_distance_bearing();
 
-    tmp >> degrees;
-    tmp >> mins;
+    Json::Value data(Json::objectValue);
+    data["latitude"] = fix.up_latitude;
+    data["longitude"] = fix.up_longitude;
+    data["altitude"] = fix.up_altitude;
+    data["chase"] = true;
 
-    double value = degrees + mins / 60;
+    hbtint::uthr->listener_telemetry(data);
+}
 
-    if (dirpart == "S" || dirpart == "W")
-        return -value;
+static int hexval(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    else if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    else if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
     else
-        return value;
+        return -1;
 }
 
-static double parse_alt(const string &part, const string &unit_part)
+/* Check the *hh checksum of a sentence and split it into fields in place.
+ * Returns the number of fields, or 0 if the sentence is not valid. */
+static int split_nmea(char *line, char **fields, int max_fields)
 {
-    if (unit_part != "M")
-        throw runtime_error("altitude units are not M");
+    char *star = strchr(line, '*');
+    if (!star)
+        return 0;
+
+    int hi = hexval(star[1]), lo = hexval(star[2]);
+    if (hi < 0 || lo < 0)
+        return 0;
+
+    unsigned char sum = 0;
+    for (const char *c = line + 1; c < star; c++)
+        sum ^= *c;
+    if (sum != hi * 16 + lo)
+        return 0;
+
+    *star = '\0';
+
+    int n = 0;
+    char *c = line;
+    fields[n++] = c;
+    while (n < max_fields && (c = strchr(c, ',')) != NULL)
+    {
+        *c++ = '\0';
+        fields[n++] = c;
+    }
 
-    istringstream tmp;
-    double value;
+    return n;
+}
 
-    tmp.exceptions(istringstream::failbit | istringstream::badbit);
-    tmp.str(part);
-    tmp >> value;
+static bool parse_hms(const char *part, char *time_str)
+{
+    for (int i = 0; i < 6; i++)
+        if (part[i] < '0' || part[i] > '9')
+            return false;
 
-    return value;
+    snprintf(time_str, 9, "%.2s:%.2s:%.2s", part, part + 2, part + 4);
+    return true;
 }
 
-void GPSThread::read()
+static bool parse_double(const char *part, double &value)
 {
-    /* Read until a newline */
-    char buf[100];
-    char *result;
-    result = fgets(buf, sizeof(buf), f);
+    char *end;
 
-    if (result != buf)
-        throw runtime_error("fgets read no data: EOF or error");
+    if (!*part)
+        return false;
+    value = strtod(part, &end);
+    return *end == '\0';
+}
 
-    /* Find the $ (i.e., discard garbage before the $) */
-    char *start = strchr(buf, '$');
+static bool parse_ddm(const char *part, const char *dirpart, double &value)
+{
+    const char *dot = strchr(part, '.');
+    if (!dot || dot - part < 3)
+        return false;
 
-    if (!start)
-        throw runtime_error("Did not find start delimiter");
+    /* Split degrees and minutes parts */
+    double degrees = 0, mins;
+    for (const char *c = part; c < dot - 2; c++)
+    {
+        if (*c < '0' || *c > '9')
+            return false;
+        degrees = degrees * 10 + (*c - '0');
+    }
+    if (!parse_double(dot - 2, mins))
+        return false;
 
-    string data(start);
-    data.erase(data.end() - 1);
+    value = degrees + mins / 60;
 
-    log("Read line: " + data);
+    if (!strcmp(dirpart, "S") || !strcmp(dirpart, "W"))
+        value = -value;
+    else if (strcmp(dirpart, "N") && strcmp(dirpart, "E"))
+        return false;
 
-    vector<string> parts;
-    split_nmea(data, parts);
+    return true;
+}
+
+/* GGA, GNS and RMC sentences from any talker (GP, GL, GA, GB, GN...) */
+void GPSThread::parse(char *line)
+{
+    char *parts[24];
+    int n = split_nmea(line, parts, 24);
 
-    if (!check_gpgga(parts))
+    if (n < 1 || strlen(parts[0]) != 6 || parts[0][1] == 'P')
         return;
 
-    string time_str;
+    const char *type = parts[0] + 3;
+    char time_str[9];
     double latitude, longitude, altitude;
 
-    try
+    if (!strcmp(type, "GGA"))
     {
-        time_str = parse_hms(parts[1]);
-        latitude = parse_ddm(parts[2], parts[3]);
-        longitude = parse_ddm(parts[4], parts[5]);
-        altitude = parse_alt(parts[9], parts[10]);
+        /* Fix quality field */
+        if (n < 11 || !strcmp(parts[6], "0") || !*parts[6])
+            return;
+        if (strcmp(parts[10], "M"))
+            return;
+        if (!parse_double(parts[9], altitude))
+            return;
     }
-    catch (out_of_range e)
+    else if (!strcmp(type, "GNS"))
     {
-        throw runtime_error("Failed to parse data (oor)");
+        /* Mode indicator, one letter per constellation; N is no fix */
+        if (n < 10 || strspn(parts[6], "N") == strlen(parts[6]))
+            return;
+        if (!parse_double(parts[9], altitude))
+            return;
     }
-    catch (istringstream::failure e)
+    else if (!strcmp(type, "RMC"))
     {
-        throw runtime_error("Failed to parse data (fail)");
+        /* RMC has no altitude: use the last one we had */
+        if (n < 7 || strcmp(parts[2], "A") || !have_altitude)
+            return;
+        altitude = last_altitude;
+        /* Shift the position fields into the GGA/GNS places */
+        parts[2] = parts[3];
+        parts[3] = parts[4];
+        parts[4] = parts[5];
+        parts[5] = parts[6];
+    }
+    else
+    {
+        return;
     }
 
-    update_ui(time_str, latitude, longitude, altitude);
-    upload(time_str, latitude, longitude, altitude);
+    if (!parse_hms(parts[1], time_str) ||
+        !parse_ddm(parts[2], parts[3], latitude) ||
+        !parse_ddm(parts[4], parts[5], longitude))
+    {
+        return;
+    }
+
+    last_altitude = altitude;
+    have_altitude = true;
+
+    publish(time_str, latitude, longitude, altitude);
 }
 
-void GPSThread::update_ui(const string &time_str,
-                          double latitude, double longitude, double altitude)
+void GPSThread::read()
 {
-    ostringstream lat_tmp, lon_tmp, alt_tmp;
-	lat_tmp << latitude;
-    lon_tmp << longitude;
-    alt_tmp << altitude;
+    ssize_t got = ::read(fd, buf + buf_len, sizeof(buf) - buf_len);
 
-    gps_pos_time->value(time_str.c_str());
-    gps_pos_lat->value(lat_tmp.str().c_str());
-    gps_pos_lon->value(lon_tmp.str().c_str());
-    gps_pos_altitude->value(alt_tmp.str().c_str());
+    if (got < 0 && errno == EINTR)
+        return;
+    if (got <= 0)
+        throw runtime_error("read() read no data: EOF or error");
 
-    gps_pos_save->activate();
+    buf_len += got;
+
+    /* Handle each complete line in place */
+    char *line = buf, *end = buf + buf_len, *nl;
+    while ((nl = (char *) memchr(line, '\n', end - line)) != NULL)
+    {
+        *nl = '\0';
+        if (nl > line && nl[-1] == '\r')
+            nl[-1] = '\0';
+
+        /* Find the $ (i.e., discard garbage before the $) */
+        char *start = strchr(line, '$');
+        if (start)
+            parse(start);
+
+        line = nl + 1;
+    }
+
+    buf_len = end - line;
+    if (buf_len == sizeof(buf))
+        buf_len = 0;        /* no newline in sight: discard garbage */
+    else
+        memmove(buf, line, buf_len);
 }
 
-void GPSThread::upload(const string &time_str,
-                       double latitude, double longitude, double altitude)
+/* Average the fixes between uploads, and publish the latest one */
+void GPSThread::publish(const char *time_str,
+                        double latitude, double longitude, double altitude)
 {
-    Fl_AutoLock lock;
-
-    LOG_DEBUG("GPS position: %s %f %f, %fM",
-              time_str.c_str(), latitude, longitude, altitude);
+    sum_latitude += latitude;
+    sum_longitude += longitude;
+    sum_altitude += altitude;
+    sum_count++;
 
-    if (time(NULL) - last_upload < rate)
-        return;
+    __sync_fetch_and_add(&fix_seq, 1);
+    write_memory_barrier();
 
-    /* Data OK? upload. */
-    if (location::current_location_mode != location::LOC_GPS)
-        throw runtime_error("GPS mode disabled mid-line");
+    memcpy(latest_fix.time_str, time_str, sizeof(latest_fix.time_str));
+    latest_fix.latitude = latitude;
+    latest_fix.longitude = longitude;
+    latest_fix.altitude = altitude;
 
-    last_upload = time(NULL);
+    if (time(NULL) - last_upload >= rate)
+    {
+        last_upload = time(NULL);
 
-    location::listener_valid = true;
-    location::listener_latitude = latitude;
-    location::listener_longitude = longitude;
-    location::listener_altitude = altitude;
-    location::update_distance_bearing();
+        latest_fix.up_latitude = sum_latitude / sum_count;
+        latest_fix.up_longitude = sum_longitude / sum_count;
+        latest_fix.up_altitude = sum_altitude / sum_count;
+        latest_fix.upload_seq++;
 
-    ostringstream temp;
+        sum_latitude = sum_longitude = sum_altitude = 0;
+        sum_count = 0;
+    }
 
-    Json::Value data(Json::objectValue);
-    // data["time"] = time_str;
-    data["latitude"] = latitude;
-    data["longitude"] = longitude;
-    data["altitude"] = altitude;
-    data["chase"] = true;
+    write_memory_barrier();
+    __sync_fetch_and_add(&fix_seq, 1);
 
-    hbtint::uthr->listener_telemetry(data);
+    if (__sync_lock_test_and_set(&fix_pending, 1) == 0)
+        Fl::awake(gps_fix_show, 0);
 }
 
 #ifndef __MINGW32__
@@ -399,14 +515,17 @@ void GPSThread::setup()
     if (fd == -1)
         throw runtime_error("open() failed");
 
-    f = fdopen(fd, "r");
-    if (f == NULL)
-        throw runtime_error("fdopen() failed");
+    buf_len = 0;
 
-    /* Line buffering */
-    int lbf = setvbuf(f, (char *) NULL, _IOLBF, 0);
-    if (lbf != 0)
-        throw runtime_error("setvbuf() failed");
+    /* Re enable blocking for reading. */
+    int set = fcntl(fd, F_SETFL, 0);
+    if (set == -1)
+        throw runtime_error("fcntl() failed");
+
+    /* A recorded NMEA log may be given instead of a serial port, and is
+     * replayed as is */
+    if (!isatty(fd))
+        return;
 
     /* Linux requires baudrates be given as a constant */
     speed_t baudrate = B4800;
@@ -443,11 +562,6 @@ void GPSThread::setup()
     /* Blocking read until 1 character arrives */
     port_settings.c_cc[VMIN] = 1;
 
-    /* Re enable blocking for reading. */
-    int set = fcntl(fd, F_SETFL, 0);
-    if (set == -1)
-        throw runtime_error("fcntl() failed");
-
     /* All baud settings */
     set = tcsetattr(fd, TCSANOW, &port_settings);
     if (set == -1)
@@ -456,14 +570,9 @@ void GPSThread::setup()
 
 void GPSThread::cleanup()
 {
-    /* The various things will close their underlying fds or handles (w32).
-     * Close the last thing we managed to open */
-    if (f)
-        fclose(f);
-    else if (fd != -1)
+    if (fd != -1)
         close(fd);
 
-    f = NULL;
     fd = -1;
 }
 #else
@@ -502,26 +611,17 @@ void GPSThread::setup()
     if (fd == -1)
         throw runtime_error("_open_osfhandle() failed");
 
-    f = fdopen(fd, "r");
-    if (!f)
-        throw runtime_error("fdopen() failed");
-
-    /* Line buffering */
-    int lbf = setvbuf(f, (char *) NULL, _IOLBF, 0);
-    if (lbf != 0)
-        throw runtime_error("setvbuf() failed");
+    buf_len = 0;
 }
 
 void GPSThread::cleanup()
 {
-    if (f)
-        fclose(f);
-    else if (fd != -1)
+    /* Closing the fd closes the underlying handle */
+    if (fd != -1)
         close(fd);
     else if (handle != INVALID_HANDLE_VALUE)
         CloseHandle(handle);
 
-    f = NULL;
     fd = -1;
     handle = INVALID_HANDLE_VALUE;
 }
@@ -12,6 +12,7 @@
 
 #include <FL/Fl.H>
 
+#include "main.h"
 #include "configuration.h"
 #include "debug.h"
 #include "fl_digi.h"
@@ -25,6 +26,7 @@
 #include "dl_fldigi/version.h"
 #include "dl_fldigi/location.h"
 #include "dl_fldigi/flights.h"
+#include "dl_fldigi/spool.h"
 
 using namespace std;
 
@@ -34,6 +36,7 @@ namespace hbtint {
 static EZ::cURLGlobal *cgl;
 DExtractorManager *extrmgr;
 DUploaderThread *uthr;
+DSpoolThread *sthr;
 static habitat::UKHASExtractor *ukhas;
 
 static EZ::Mutex rig_mutex;
@@ -48,6 +51,8 @@ void init()
     uthr = new DUploaderThread();
     extrmgr = new DExtractorManager(*uthr);
 
+    sthr = new DSpoolThread(HomeDir + "upload_spool.json");
+
     ukhas = new habitat::UKHASExtractor();
     extrmgr->add(*ukhas);
 }
@@ -55,6 +60,7 @@ void init()
 void start()
 {
     uthr->start();
+    sthr->start();
 }
 
 void cleanup()
@@ -74,6 +80,12 @@ void cleanup()
     while (uthr)
         Fl::wait();
 
+    if (sthr)
+        sthr->shutdown();
+
+    while (sthr)
+        Fl::wait();
+
     delete cgl;
     cgl = 0;
 }
@@ -114,6 +126,40 @@ void *DUploaderThread::run()
     return ret;
 }
 
+static void sthr_thread_death(void *what)
+{
+    if (what != sthr)
+    {
+        LOG_ERROR("unknown thread");
+        return;
+    }
+
+    LOG_INFO("cleaning up spool");
+    sthr->join();
+    delete sthr;
+    sthr = 0;
+}
+
+void *DSpoolThread::run()
+{
+    void *ret = SpoolThread::run();
+    Fl::awake(sthr_thread_death, this);
+    return ret;
+}
+
+/* Telemetry is only spooled while it could be sent: going offline means
+ * nothing is collected for later. Called with the FLTK lock held. */
+static bool can_upload()
+{
+    if (online() && progdefaults.myCall.size() &&
+        progdefaults.habitat_uri.size() && progdefaults.habitat_db.size())
+        return true;
+
+    status_important("Can't upload! Either in offline mode, or "
+                     "your callsign is not set.");
+    return false;
+}
+
 /* Some functions below are called via a DUploaderThread pointer so
  * the fact that they are non virtual is OK. Having a different set of
  * arguments even prevents the wrong function from being selected.
@@ -125,6 +171,7 @@ void DUploaderThread::settings()
     Fl_AutoLock lock;
 
     UploaderThread::reset();
+    sthr->reset();
 
     if (!online())
     {
@@ -141,6 +188,8 @@ void DUploaderThread::settings()
 
     UploaderThread::settings(progdefaults.myCall, progdefaults.habitat_uri,
                              progdefaults.habitat_db);
+    sthr->settings(progdefaults.myCall, progdefaults.habitat_uri,
+                   progdefaults.habitat_db);
 }
 
 void DUploaderThread::payload_telemetry(const string &data,
@@ -148,6 +197,9 @@ void DUploaderThread::payload_telemetry(const string &data,
 {
     Fl_AutoLock lock;
 
+    if (!can_upload())
+        return;
+
     /* If the frequency/mode from the rig is recent, upload it.
      * null metadata is automatically converted to an object by jsoncpp */
 
@@ -163,7 +215,9 @@ void DUploaderThread::payload_telemetry(const string &data,
     Json::Value new_metadata = metadata;
     new_metadata["rig_info"] = rig_info;
 
-    UploaderThread::payload_telemetry(data, new_metadata, time_created);
+    /* Telemetry goes through the spool, so that it survives network
+     * outages and restarts */
+    sthr->payload_telemetry(data, new_metadata, time_created);
 }
 
 
@@ -182,7 +236,7 @@ void DUploaderThread::listener_telemetry()
 
     location::update_stationary();
 
-    if (!location::listener_valid)
+    if (!location::listener_valid || !can_upload())
         return;
 
     Json::Value data(Json::objectValue);
@@ -192,7 +246,7 @@ void DUploaderThread::listener_telemetry()
     if (location::listener_altitude != 0)
         data["altitude"] = location::listener_altitude;
 
-    UploaderThread::listener_telemetry(data);
+    sthr->listener_telemetry(data, -1);
 }
 
 void DUploaderThread::listener_telemetry(const Json::Value &data)
@@ -203,7 +257,10 @@ void DUploaderThread::listener_telemetry(const Json::Value &data)
         throw runtime_error("Attempted to upload GPS data while not "
                             "in GPS mode");
 
-    UploaderThread::listener_telemetry(data);
+    if (!can_upload())
+        return;
+
+    sthr->listener_telemetry(data, -1);
 }
 
 static void info_add(Json::Value &data, const string &key, const string &value)
@@ -374,17 +431,20 @@ void DExtractorManager::data(const Json::Value &d)
         istringstream lat_strm(d["latitude"].asString());
         istringstream lon_strm(d["longitude"].asString());
         istringstream alt_strm(d["altitude"].asString());
-        lat_strm >> location::balloon_latitude;
-        lon_strm >> location::balloon_longitude;
-        alt_strm >> location::balloon_altitude;
-        location::balloon_valid = !lat_strm.fail() && !lon_strm.fail() &&
-                                  !alt_strm.fail();
-    }
-    else
-    {
-        location::balloon_valid = false;
+        double lat, lon, alt;
+        lat_strm >> lat;
+        lon_strm >> lon;
+        alt_strm >> alt;
+
+        if (!lat_strm.fail() && !lon_strm.fail() && !alt_strm.fail())
+        {
+            location::payload_position(d["payload"].asString(),
+                                       lat, lon, alt);
+            return;
+        }
     }
 
+    location::balloon_valid = false;
     location::update_distance_bearing();
 }
 
@@ -9,6 +9,10 @@
 #include "dl_fldigi/location.h"
 
 #include <sstream>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <math.h>
 
 #include "configuration.h"
 #include "fl_digi.h"
@@ -27,6 +31,16 @@ double listener_latitude, listener_longitude, listener_altitude,
        balloon_latitude, balloon_longitude, balloon_altitude;
 bool listener_valid, balloon_valid;
 
+static const double radius = 6371000.0;
+
+/* Tracked payloads, and their positions laid out for compute_ranges() */
+static vector<payload_track> tracks;
+static int shown_track = -1;
+static double t_sin_lat[max_tracked], t_cos_lat[max_tracked],
+              t_lon[max_tracked], t_alt[max_tracked];
+static double t_distance[max_tracked], t_bearing[max_tracked],
+              t_elevation[max_tracked];
+
 void start()
 {
     if (progdefaults.gps_start_enabled)
@@ -37,14 +51,234 @@ void start()
     gps::configure_gps();
 }
 
+/* Distance, bearing and elevation from the listener to tracks [first, last)
+ * See habitat-autotracker/autotracker/earthmaths.py. The listener terms are
+ * worked out once, and the loop only touches the t_* arrays. */
+static void compute_ranges(int first, int last)
+{
+    const double c = M_PI/180;
+    const double lat1 = listener_latitude * c;
+    const double lon1 = listener_longitude * c;
+    const double sin_lat1 = sin(lat1), cos_lat1 = cos(lat1);
+    const double ta = radius + listener_altitude;
+
+    for (int i = first; i < last; i++)
+    {
+        double d_lon = t_lon[i] - lon1;
+        double sin_d_lon = sin(d_lon), cos_d_lon = cos(d_lon);
+
+        double sa = t_cos_lat[i] * sin_d_lon;
+        double sb = (cos_lat1 * t_sin_lat[i]) -
+                    (sin_lat1 * t_cos_lat[i] * cos_d_lon);
+        double aa = sqrt((sa * sa) + (sb * sb));
+        double ab = (sin_lat1 * t_sin_lat[i]) +
+                    (cos_lat1 * t_cos_lat[i] * cos_d_lon);
+
+        /* cos and sin of the angle at the centre are ab and aa, scaled */
+        double h = sqrt((aa * aa) + (ab * ab));
+        double cos_centre = h ? ab / h : 1, sin_centre = h ? aa / h : 0;
+
+        double tb = radius + t_alt[i];
+        double ea = (cos_centre * tb) - ta;
+        double eb = sin_centre * tb;
+
+        double bearing = atan2(sa, sb) * (180/M_PI);
+        if (bearing < 0)
+            bearing += 360;
+
+        t_bearing[i] = bearing;
+        t_elevation[i] = atan2(ea, eb) * (180/M_PI);
+        t_distance[i] = sqrt((ta * ta) + (tb * tb) -
+                             2 * tb * ta * cos_centre) / 1000;
+    }
+
+    for (int i = first; i < last; i++)
+    {
+        tracks[i].range_valid = listener_valid;
+        tracks[i].distance = t_distance[i];
+        tracks[i].bearing = t_bearing[i];
+        tracks[i].elevation = t_elevation[i];
+    }
+}
+
+/* Add p to the fit, or take it out again (sign = -1) */
+static void fit_point(payload_track &t, const track_point &p, int sign)
+{
+    double dt = difftime(p.time, t.epoch);
+
+    t.sum_t += sign * dt;
+    t.sum_tt += sign * dt * dt;
+    t.sum_alt += sign * p.altitude;
+    t.sum_t_alt += sign * dt * p.altitude;
+    t.sum_lat += sign * p.latitude;
+    t.sum_t_lat += sign * dt * p.latitude;
+    t.sum_lon += sign * p.longitude;
+    t.sum_t_lon += sign * dt * p.longitude;
+}
+
+static void update_fit(payload_track &t)
+{
+    int n = min(t.count, (int) track_window);
+    double denom = n * t.sum_tt - t.sum_t * t.sum_t;
+
+    if (n < 2 || denom <= 0)
+    {
+        t.ascent_rate = t.lat_rate = t.lon_rate = 0;
+        t.landing_valid = false;
+        return;
+    }
+
+    t.ascent_rate = (n * t.sum_t_alt - t.sum_t * t.sum_alt) / denom;
+    t.lat_rate = (n * t.sum_t_lat - t.sum_t * t.sum_lat) / denom;
+    t.lon_rate = (n * t.sum_t_lon - t.sum_t * t.sum_lon) / denom;
+
+    const track_point &p = t.latest();
+    double ground = listener_valid ? listener_altitude : 0;
+
+    t.landing_valid = t.ascent_rate < -1 && p.altitude > ground;
+    if (!t.landing_valid)
+        return;
+
+    double seconds = (p.altitude - ground) / -t.ascent_rate;
+    t.landing_time = p.time + (time_t) seconds;
+    t.landing_latitude = p.latitude + t.lat_rate * seconds;
+    t.landing_longitude = p.longitude + t.lon_rate * seconds;
+}
+
+static int add_track(const string &name)
+{
+    int index = tracks.size();
+
+    if (index == max_tracked)
+    {
+        /* Forget the payload we heard from longest ago */
+        index = 0;
+        for (int i = 1; i < max_tracked; i++)
+        {
+            if (tracks[i].latest().time < tracks[index].latest().time)
+                index = i;
+        }
+
+        if (shown_track == index)
+            shown_track = -1;
+    }
+    else
+    {
+        tracks.reserve(max_tracked);
+        tracks.push_back(payload_track());
+    }
+
+    /* value-initialised: all the sums and flags are zero */
+    tracks[index] = payload_track();
+    tracks[index].name = name;
+    tracks[index].epoch = time(NULL);
+
+    return index;
+}
+
+void payload_position(const string &name, double latitude,
+                      double longitude, double altitude)
+{
+    Fl_AutoLock lock;
+
+    int index;
+    const payload_track *found = find_tracked(name);
+
+    if (found)
+        index = found - &tracks[0];
+    else
+        index = add_track(name);
+
+    payload_track &t = tracks[index];
+
+    if (t.count >= track_window)
+    {
+        int oldest = (t.head + track_history - track_window) % track_history;
+        fit_point(t, t.history[oldest], -1);
+    }
+
+    track_point &p = t.history[t.head];
+    p.time = time(NULL);
+    p.latitude = latitude;
+    p.longitude = longitude;
+    p.altitude = altitude;
+
+    t.head = (t.head + 1) % track_history;
+    if (t.count < track_history)
+        t.count++;
+
+    fit_point(t, p, 1);
+    update_fit(t);
+
+    const double c = M_PI/180;
+    t_sin_lat[index] = sin(latitude * c);
+    t_cos_lat[index] = cos(latitude * c);
+    t_lon[index] = longitude * c;
+    t_alt[index] = altitude;
+
+    balloon_latitude = latitude;
+    balloon_longitude = longitude;
+    balloon_altitude = altitude;
+    balloon_valid = true;
+    shown_track = index;
+
+    if (listener_valid)
+        compute_ranges(index, index + 1);
+
+    update_distance_bearing();
+}
+
+int tracked_count()
+{
+    return tracks.size();
+}
+
+const payload_track &tracked(int index)
+{
+    return tracks[index];
+}
+
+const payload_track *find_tracked(const string &name)
+{
+    for (size_t i = 0; i < tracks.size(); i++)
+    {
+        if (tracks[i].name == name)
+            return &tracks[i];
+    }
+
+    return NULL;
+}
+
+/* Called when the listener moves, or a payload position arrives. Only
+ * the payload shown in the UI is formatted */
 void update_distance_bearing()
 {
     Fl_AutoLock lock;
 
+    static double last_latitude, last_longitude, last_altitude;
+    static bool last_valid;
+
+    if (listener_valid && (!last_valid ||
+                           last_latitude != listener_latitude ||
+                           last_longitude != listener_longitude ||
+                           last_altitude != listener_altitude))
+    {
+        compute_ranges(0, tracks.size());
+
+        for (size_t i = 0; i < tracks.size(); i++)
+            update_fit(tracks[i]);
+
+        last_latitude = listener_latitude;
+        last_longitude = listener_longitude;
+        last_altitude = listener_altitude;
+    }
+
+    last_valid = listener_valid;
+
     if (!hab_ui_exists)
         return;
 
-    if (!listener_valid || !balloon_valid)
+    if (!listener_valid || !balloon_valid || shown_track == -1)
     {
         //habDistance->value("");
         //habBearing->value("");
@@ -52,65 +286,16 @@ void update_distance_bearing()
         return;
     }
 
-    /* See habitat-autotracker/autotracker/earthmaths.py. */
-    double c = M_PI/180;
-    double lat1, lon1, lat2, lon2, alt1, alt2;
-    lat1 = listener_latitude * c;
-    lon1 = listener_longitude * c;
-    alt1 = listener_altitude;
-    lat2 = balloon_latitude * c;
-    lon2 = balloon_longitude * c;
-    alt2 = balloon_altitude;
-
-    double radius, d_lon, sa, sb, bearing, aa, ab, angle_at_centre,
-           great_circle_distance, ta, tb, ea, eb, elevation, distance;
-
-    radius = 6371000.0;
-
-    d_lon = lon2 - lon1;
-    sa = cos(lat2) * sin(d_lon);
-    sb = (cos(lat1) * sin(lat2)) - (sin(lat1) * cos(lat2) * cos(d_lon));
-    bearing = atan2(sa, sb);
-    aa = sqrt((sa * sa) + (sb * sb));
-    ab = (sin(lat1) * sin(lat2)) + (cos(lat1) * cos(lat2) * cos(d_lon));
-    angle_at_centre = atan2(aa, ab);
-    great_circle_distance = angle_at_centre * radius;
-
-    ta = radius + alt1;
-    tb = radius + alt2;
-    ea = (cos(angle_at_centre) * tb) - ta;
-    eb = sin(angle_at_centre) * tb;
-    elevation = atan2(ea, eb);
-
-    distance = sqrt((ta * ta) + (tb * tb) -
-                    2 * tb * ta * cos(angle_at_centre));
-
-    bearing *= (180/M_PI);
-    elevation *= (180/M_PI);
-    distance /= 1000;
-
-    if (bearing < 0)
-        bearing += 360;
-
-    ostringstream str_distance;
-    str_distance.precision(4);
-    str_distance << distance << "km";
-
-    ostringstream str_bearing;
-    str_bearing.setf(ios::fixed, ios::floatfield);
-    str_bearing.precision(1);
-    str_bearing.fill('0');
-    str_bearing.width(3 + 1 + 1);
-    str_bearing << bearing;
-
-    ostringstream str_elevation;
-    str_elevation.setf(ios::fixed, ios::floatfield);
-    str_elevation.precision(1);
-    str_elevation << elevation;
-
-    habDistance->value(str_distance.str().c_str());
-    habBearing->value(str_bearing.str().c_str());
-    habElevation->value(str_elevation.str().c_str());
+    const payload_track &t = tracks[shown_track];
+    char str_distance[32], str_bearing[16], str_elevation[16];
+
+    snprintf(str_distance, sizeof(str_distance), "%.4gkm", t.distance);
+    snprintf(str_bearing, sizeof(str_bearing), "%05.1f", t.bearing);
+    snprintf(str_elevation, sizeof(str_elevation), "%.1f", t.elevation);
+
+    habDistance->value(str_distance);
+    habBearing->value(str_bearing);
+    habElevation->value(str_elevation);
 }
 
 void update_stationary()
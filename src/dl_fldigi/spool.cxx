@@ -0,0 +1,562 @@
+/*
+ * Copyright (C) 2012 Daniel Richman
+ * License: GNU GPL 3
+ *
+ * spool.cxx: On-disk queue of telemetry and SSDV packets to upload
+ */
+
+#include "dl_fldigi/spool.h"
+
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <curl/curl.h>
+
+#include "debug.h"
+#include "fl_digi.h"
+#include "threads.h"
+
+#include "jsoncpp.h"
+#include "habitat/EZ.h"
+#include "habitat/Uploader.h"
+
+#include "dl_fldigi/dl_fldigi.h"
+
+using namespace std;
+
+namespace dl_fldigi {
+namespace spool {
+
+/* Records sent per wakeup, over the same connection */
+static const size_t batch_size = 16;
+static const int max_backoff = 64;
+static const size_t recent_keys_max = 256;
+/* Limits of the queue: a flight's worth of telemetry, and no older */
+static const size_t max_records = 5000;
+static const time_t max_age = 6 * 60 * 60;
+
+SpoolThread::SpoolThread(const string &f)
+    : filename(f), file(NULL), dirty(false), term(false), next_seq(1),
+      configured(false), changed(false), retry_at(0), backoff(0)
+{
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cond, NULL);
+
+    replay();
+
+    file = fopen(filename.c_str(), "a");
+    if (!file)
+        LOG_WARN("unable to open %s, uploads will not survive a restart",
+                 filename.c_str());
+}
+
+SpoolThread::~SpoolThread()
+{
+    if (file)
+        fclose(file);
+
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&lock);
+}
+
+/* Called from the constructor, before the thread is started: queue the
+ * records that were never acked and write them back to a fresh file */
+void SpoolThread::replay()
+{
+    ifstream in(filename.c_str());
+    if (in.fail())
+        return;
+
+    map<unsigned long, Json::Value> records;
+    string line;
+    time_t now = time(NULL);
+    size_t dropped = 0;
+
+    while (getline(in, line))
+    {
+        Json::Reader reader;
+        Json::Value root;
+
+        /* A crash may have left a partial last line */
+        if (!reader.parse(line, root, false) || !root.isObject())
+            continue;
+
+        if (root.isMember("ack"))
+            records.erase(root["ack"].asUInt());
+        else if (root.isMember("seq"))
+            records[root["seq"].asUInt()] = root;
+    }
+
+    in.close();
+
+    for (map<unsigned long, Json::Value>::iterator it = records.begin();
+         it != records.end(); )
+    {
+        if (records.size() > max_records ||
+            it->second.get("queued", (int) now).asInt() < now - max_age)
+        {
+            records.erase(it++);
+            dropped++;
+        }
+        else
+            it++;
+    }
+
+    if (dropped)
+        LOG_WARN("%zu old records dropped from %s", dropped, filename.c_str());
+
+    string temp = filename + ".tmp";
+    ofstream out(temp.c_str(), ios_base::out | ios_base::trunc);
+
+    for (map<unsigned long, Json::Value>::iterator it = records.begin();
+         it != records.end() && out.good(); it++)
+    {
+        record r;
+        r.seq = next_seq++;
+        r.value = it->second;
+        r.value["seq"] = (Json::UInt) r.seq;
+        r.queued = r.value.get("queued", (int) now).asInt();
+        r.value["queued"] = (int) r.queued;
+        pending.push_back(r);
+
+        Json::FastWriter writer;
+        out << writer.write(r.value);
+    }
+
+    bool success = out.good();
+    out.close();
+
+    if (success && rename(temp.c_str(), filename.c_str()) == 0)
+    {
+        if (pending.size())
+            LOG_INFO("%zu records left to upload from last session",
+                     pending.size());
+    }
+    else
+    {
+        LOG_WARN("unable to rewrite %s", filename.c_str());
+        unlink(temp.c_str());
+    }
+}
+
+/* Called with lock held. Lines reach the file in queue order, but the
+ * fsync is left to the spool thread so that append() never waits on the
+ * disk while the GUI holds it up */
+void SpoolThread::write_line(const Json::Value &line)
+{
+    if (!file)
+        return;
+
+    Json::FastWriter writer;
+    string s = writer.write(line);
+
+    if (fwrite(s.data(), s.size(), 1, file) != 1 || fflush(file) != 0)
+    {
+        LOG_WARN("unable to write to %s", filename.c_str());
+        return;
+    }
+
+    dirty = true;
+}
+
+/* Called from the spool thread with lock held; drops it around the fsync.
+ * Only this thread reopens file, so the descriptor stays valid. */
+void SpoolThread::sync()
+{
+    if (!dirty || !file)
+        return;
+
+    dirty = false;
+    int fd = fileno(file);
+
+    pthread_mutex_unlock(&lock);
+#ifndef __MINGW32__
+    fsync(fd);
+#else
+    (void) fd;
+#endif
+    pthread_mutex_lock(&lock);
+}
+
+void SpoolThread::append(const string &key, Json::Value &value)
+{
+    pthread_mutex_lock(&lock);
+
+    if (key.size())
+    {
+        if (recent_keys.count(key))
+        {
+            pthread_mutex_unlock(&lock);
+            return;
+        }
+
+        recent_keys.insert(key);
+        recent_order.push_back(key);
+        if (recent_order.size() > recent_keys_max)
+        {
+            recent_keys.erase(recent_order.front());
+            recent_order.pop_front();
+        }
+    }
+
+    record r;
+    r.seq = next_seq++;
+    r.queued = time(NULL);
+    r.key = key;
+    r.value = value;
+    r.value["seq"] = (Json::UInt) r.seq;
+    r.value["queued"] = (int) r.queued;
+
+    size_t dropped = expire(r.queued);
+
+    write_line(r.value);
+    pending.push_back(r);
+
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+
+    if (dropped)
+    {
+        ostringstream msg;
+        msg << dropped << " unsent records dropped from the upload spool";
+        warning(msg.str());
+    }
+}
+
+/* Called with lock held: ack the oldest records to make room for one more
+ * and to get rid of stale ones. Returns the number dropped. */
+size_t SpoolThread::expire(time_t now)
+{
+    size_t n = 0;
+
+    while (pending.size() &&
+           (pending.size() >= max_records ||
+            pending.front().queued < now - max_age))
+    {
+        Json::Value line(Json::objectValue);
+        line["ack"] = (Json::UInt) pending.front().seq;
+        write_line(line);
+        pending.pop_front();
+        n++;
+    }
+
+    return n;
+}
+
+/* Called with lock held */
+void SpoolThread::ack(unsigned long seq)
+{
+    for (deque<record>::iterator it = pending.begin();
+         it != pending.end(); it++)
+    {
+        if (it->seq == seq)
+        {
+            pending.erase(it);
+            break;
+        }
+    }
+
+    if (pending.empty() && file)
+    {
+        /* Nothing left: start again with an empty file */
+        FILE *f = freopen(filename.c_str(), "w", file);
+        if (f)
+        {
+            file = f;
+            return;
+        }
+
+        /* freopen has closed the old stream: go on appending, and ack as
+         * usual so that a restart doesn't send the records again */
+        file = fopen(filename.c_str(), "a");
+        notice = "Unable to truncate " + filename;
+        if (!file)
+        {
+            notice += ", upload spool not saved to disk";
+            return;
+        }
+    }
+
+    Json::Value line(Json::objectValue);
+    line["ack"] = (Json::UInt) seq;
+    write_line(line);
+}
+
+bool SpoolThread::sendable(const record &r) const
+{
+    return configured || r.value["type"].asString() == "ssdv";
+}
+
+void SpoolThread::settings(const string &c, const string &u, const string &d)
+{
+    pthread_mutex_lock(&lock);
+    callsign = c;
+    couch_uri = u;
+    couch_db = d;
+    configured = changed = true;
+    retry_at = 0;
+    backoff = 0;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+/* Stop uploading to habitat (e.g., offline); records are still spooled */
+void SpoolThread::reset()
+{
+    pthread_mutex_lock(&lock);
+    configured = false;
+    changed = true;
+    pthread_mutex_unlock(&lock);
+}
+
+void SpoolThread::payload_telemetry(const string &data,
+        const Json::Value &metadata, int time_created)
+{
+    Json::Value value(Json::objectValue);
+    value["type"] = "payload_telemetry";
+    value["data"] = data;
+    value["metadata"] = metadata;
+    value["time_created"] = time_created == -1 ? (int) time(NULL)
+                                               : time_created;
+
+    append("payload_telemetry:" + data, value);
+}
+
+void SpoolThread::listener_telemetry(const Json::Value &data, int time_created)
+{
+    Json::Value value(Json::objectValue);
+    value["type"] = "listener_telemetry";
+    value["data"] = data;
+    value["time_created"] = time_created == -1 ? (int) time(NULL)
+                                               : time_created;
+
+    append("", value);
+}
+
+void SpoolThread::ssdv_packet(const string &url, const string &callsign,
+                              const string &packet, int fixes)
+{
+    Json::Value value(Json::objectValue);
+    value["type"] = "ssdv";
+    value["url"] = url;
+    value["callsign"] = callsign;
+    value["packet"] = packet;
+    value["fixes"] = fixes;
+
+    append("ssdv:" + packet, value);
+}
+
+void SpoolThread::shutdown()
+{
+    pthread_mutex_lock(&lock);
+    term = true;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+/* Throws runtime_error if the record should be tried again later */
+void SpoolThread::send(habitat::Uploader *uploader, const Json::Value &value)
+{
+    const string type = value["type"].asString();
+
+    if (type == "payload_telemetry")
+        uploader->payload_telemetry(value["data"].asString(),
+                                    value["metadata"],
+                                    value["time_created"].asInt());
+    else if (type == "listener_telemetry")
+        uploader->listener_telemetry(value["data"],
+                                     value["time_created"].asInt());
+    else if (type == "ssdv")
+        send_ssdv(value);
+    else
+        throw invalid_argument("unknown record type " + type);
+}
+
+void SpoolThread::send_ssdv(const Json::Value &value)
+{
+    struct curl_httppost *post = NULL, *last = NULL;
+    ostringstream fixes;
+    fixes << value["fixes"].asInt();
+
+    curl_formadd(&post, &last, CURLFORM_COPYNAME, "callsign",
+        CURLFORM_COPYCONTENTS, value["callsign"].asCString(), CURLFORM_END);
+    curl_formadd(&post, &last, CURLFORM_COPYNAME, "encoding",
+        CURLFORM_COPYCONTENTS, "hex", CURLFORM_END);
+    curl_formadd(&post, &last, CURLFORM_COPYNAME, "fixes",
+        CURLFORM_COPYCONTENTS, fixes.str().c_str(), CURLFORM_END);
+    curl_formadd(&post, &last, CURLFORM_COPYNAME, "packet",
+        CURLFORM_COPYCONTENTS, value["packet"].asCString(), CURLFORM_END);
+
+    CURL *curl = curl_easy_init();
+    if (!curl)
+    {
+        curl_formfree(post);
+        throw runtime_error("curl_easy_init() failed");
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, value["url"].asCString());
+    curl_easy_setopt(curl, CURLOPT_HTTPPOST, post);
+
+    CURLcode r = curl_easy_perform(curl);
+    long code = 0;
+    if (r == CURLE_OK)
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+
+    curl_easy_cleanup(curl);
+    curl_formfree(post);
+
+    if (r != CURLE_OK)
+        throw runtime_error(string("SSDV upload failed: ") +
+                            curl_easy_strerror(r));
+    if (code >= 500)
+        throw runtime_error("SSDV upload failed: server error");
+}
+
+void *SpoolThread::run()
+{
+    habitat::Uploader *uploader = NULL;
+
+    pthread_mutex_lock(&lock);
+
+    while (!term)
+    {
+        sync();
+
+        time_t now = time(NULL);
+
+        /* Pick the next records that can be sent */
+        vector<record> batch;
+        for (deque<record>::iterator it = pending.begin();
+             it != pending.end() && batch.size() < batch_size; it++)
+        {
+            if (sendable(*it))
+                batch.push_back(*it);
+        }
+
+        /* Lines appended during the last sync have not been signalled */
+        if (batch.empty())
+        {
+            if (!dirty)
+                pthread_cond_wait(&cond, &lock);
+            continue;
+        }
+
+        if (retry_at > now)
+        {
+            if (!dirty)
+                pthread_cond_timedwait_rel(&cond, &lock, retry_at - now);
+            continue;
+        }
+
+        if (changed)
+        {
+            delete uploader;
+            uploader = NULL;
+            changed = false;
+        }
+
+        if (!uploader && configured)
+            uploader = new habitat::Uploader(callsign, couch_uri, couch_db);
+
+        habitat::Uploader *u = uploader;
+
+        pthread_mutex_unlock(&lock);
+
+        size_t n;
+        for (n = 0; n < batch.size(); n++)
+        {
+            const string type = batch[n].value["type"].asString();
+            bool done = true;
+            string error;
+
+            try
+            {
+                if (type != "ssdv" && !u)
+                    break;
+                send(u, batch[n].value);
+                log("Uploaded " + type + " successfully");
+            }
+            catch (habitat::UnmergeableError &e)
+            {
+                warning("Can't upload " + type + ": unmergeable, dropped");
+            }
+            catch (invalid_argument &e)
+            {
+                warning(string("Can't upload! Bad record dropped: ") +
+                        e.what());
+            }
+            catch (runtime_error &e)
+            {
+                error = e.what();
+                done = false;
+            }
+
+            pthread_mutex_lock(&lock);
+            if (done)
+            {
+                ack(batch[n].seq);
+                backoff = 0;
+            }
+            else
+            {
+                /* 1, 2, 4 ... 64 seconds */
+                backoff = backoff ? min(backoff * 2, max_backoff) : 1;
+                retry_at = time(NULL) + backoff;
+            }
+            sync();
+            bool stop = !done || term || changed;
+            size_t backlog = pending.size();
+            int wait = backoff;
+            string trouble;
+            trouble.swap(notice);
+            pthread_mutex_unlock(&lock);
+
+            if (trouble.size())
+                warning(trouble);
+
+            if (!done)
+            {
+                ostringstream msg;
+                msg << "Can't upload! " << error << "; " << backlog
+                    << " queued, retrying in " << wait << "s";
+                warning(msg.str());
+            }
+
+            if (stop)
+                break;
+        }
+
+        pthread_mutex_lock(&lock);
+    }
+
+    sync();
+    pthread_mutex_unlock(&lock);
+
+    delete uploader;
+    return NULL;
+}
+
+/* These take the FLTK lock, so never call them with lock held */
+void SpoolThread::log(const string &message)
+{
+    Fl_AutoLock lock;
+    LOG_DEBUG("hbtSP %s", message.c_str());
+    status(message);
+}
+
+void SpoolThread::warning(const string &message)
+{
+    Fl_AutoLock lock;
+    LOG_WARN("hbtSP %s", message.c_str());
+    status_important(message);
+}
+
+} /* namespace spool */
+} /* namespace dl_fldigi */
@@ -613,18 +613,11 @@ int dominoex::get_secondary_char()
 
 void dominoex::sendtone(int tone, int duration)
 {
-	double f, phaseincr;
-	f = (tone + 0.5) * tonespacing + get_txfreq_woffset() - bandwidth / 2.0;
-	phaseincr = TWOPI * f / samplerate;
+	double f0 = 0.5 * tonespacing + get_txfreq_woffset() - bandwidth / 2.0;
+	if (!txtones.matches(NUMTONES, f0, tonespacing, symlen, samplerate))
+		txtones.build(NUMTONES, f0, tonespacing, symlen, samplerate);
 	for (int j = 0; j < duration; j++) {
-		for (int i = 0; i < symlen; i++) {
-			outbuf[i] = cos(txphase);
-			txphase -= phaseincr;
-			if (txphase > M_PI)
-				txphase -= TWOPI;
-			else if (txphase < M_PI)
-				txphase += TWOPI;
-		}
+		txtones.render(outbuf, tone, txphase);
 		ModulateXmtr(outbuf, symlen);
 	}
 }
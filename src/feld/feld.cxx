@@ -202,7 +202,7 @@ feld::feld(trx_mode m)
 	hardkeying = false;
 
 	rxphacc = 0.0;
-	txphacc = 0.0;
+	txosc.reset();
 
 }
 
@@ -442,18 +442,6 @@ int feld::get_font_data(unsigned char c, int col)
 	return bits;
 }
 
-double feld::nco(double freq)
-{
-	double x = sin(txphacc);
-
-	txphacc += 2.0 * M_PI * freq / samplerate;
-
-	if (txphacc > M_PI)
-		txphacc -= 2.0 * M_PI;
-
-	return x;
-}
-
 void feld::send_symbol(int currsymb, int nextsymb)
 {
 	double tone = get_txfreq_woffset();
@@ -466,12 +454,15 @@ void feld::send_symbol(int currsymb, int nextsymb)
 		tone += (reverse ? -1 : 1) * (prevsymb ? -1 : 1) * bandwidth / 2.0;
 		tone2 += (reverse ? -1 : 1) * (currsymb ? -1 : 1) * bandwidth / 2.0;
 	}
+	txosc.set_freq(tone, samplerate);
 	for (;;) {
 		switch (mode) {
-			ncoval = nco(tone);
+			ncoval = txosc.sin();
 			case MODE_FSKHELL : case MODE_FSKH105 : case MODE_HELL80 :
-				if ((tone2 != tone) && ((1.0 - fabs(ncoval)) < .001)) 
+				if ((tone2 != tone) && ((1.0 - fabs(ncoval)) < .001)) {
 					tone = tone2;
+					txosc.set_freq(tone, samplerate);
+				}
 				break;
 			case MODE_HELLX5 : case MODE_HELLX9 :
 				Amp = currsymb;
@@ -486,7 +477,8 @@ void feld::send_symbol(int currsymb, int nextsymb)
 					Amp = currsymb;
 				break;
 		}
-		outbuf[outlen++] = Amp * nco(tone);
+		outbuf[outlen++] = Amp * txosc.sin();
+		txosc.step();
 
 		if (outlen >= OUTBUFSIZE) {
 			LOG_DEBUG("feld reset");
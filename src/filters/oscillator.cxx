@@ -0,0 +1,34 @@
+// ----------------------------------------------------------------------------
+// oscillator.cxx  --  table driven, phase continuous tone generator
+//
+// This file is part of fldigi.
+//
+// Fldigi is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Fldigi is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with fldigi.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#include <config.h>
+
+#include "oscillator.h"
+
+double oscillator::table[OSC_TABLE_SIZE + 1];
+
+// one full cycle plus a guard entry for the interpolation
+bool oscillator::init_table()
+{
+	for (int i = 0; i <= OSC_TABLE_SIZE; i++)
+		table[i] = ::sin(2.0 * M_PI * i / OSC_TABLE_SIZE);
+	return true;
+}
+
+bool oscillator::table_ok = oscillator::init_table();
@@ -0,0 +1,83 @@
+// ----------------------------------------------------------------------------
+// tonecache.cxx  --  pre-rendered tones for the MFSK family transmitters
+//
+// This file is part of fldigi.
+//
+// Fldigi is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Fldigi is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with fldigi.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#include <config.h>
+
+#include <cmath>
+
+#include "tonecache.h"
+
+tone_cache::tone_cache()
+	: ntones(0), len(0), f0(0), spacing(0), sr(0), ctab(0), stab(0), step(0)
+{
+}
+
+tone_cache::~tone_cache()
+{
+	delete [] ctab;
+	delete [] stab;
+	delete [] step;
+}
+
+bool tone_cache::matches(int n, double f, double sp, int symlen, double samplerate) const
+{
+	return ctab && n == ntones && f == f0 && sp == spacing &&
+		symlen == len && samplerate == sr;
+}
+
+void tone_cache::build(int n, double f, double sp, int symlen, double samplerate)
+{
+	if (n * symlen != ntones * len) {
+		delete [] ctab;
+		delete [] stab;
+		ctab = new double[n * symlen];
+		stab = new double[n * symlen];
+	}
+	if (n != ntones) {
+		delete [] step;
+		step = new double[n];
+	}
+
+	ntones = n;
+	f0 = f;
+	spacing = sp;
+	len = symlen;
+	sr = samplerate;
+
+	for (int k = 0; k < ntones; k++) {
+		double w = 2.0 * M_PI * (f0 + k * spacing) / sr;
+		double *c = ctab + k * len, *s = stab + k * len;
+		for (int i = 0; i < len; i++) {
+			c[i] = cos(i * w);
+			s[i] = sin(i * w);
+		}
+		step[k] = len * w;
+	}
+}
+
+void tone_cache::render(double *buf, int tone, double& phase) const
+{
+	const double *c = ctab + tone * len, *s = stab + tone * len;
+	double cp = cos(phase), sp = sin(phase);
+
+	for (int i = 0; i < len; i++)
+		buf[i] = cp * c[i] + sp * s[i];
+
+	phase = fmod(phase - step[tone], 2.0 * M_PI);
+}
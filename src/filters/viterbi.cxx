@@ -29,6 +29,10 @@
 #include <string.h>
 #include <limits.h>
 
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
 #include "viterbi.h"
 #include "misc.h"
 
@@ -39,19 +43,29 @@ viterbi::viterbi(int k, int poly1, int poly2)
 	_traceback = PATHMEM - 1;
 	_chunksize = 8;
 	nstates = 1 << (k - 1);
+	topbit = nstates >> 1;
+	nwords = (nstates + 31) / 32;
 	
 	output = new int[outsize];
 	
 	for (int i = 0; i < outsize; i++) {
 		output[i] = parity(poly1 & i) | (parity(poly2 & i) << 1);
 	}
-	
+
+// Sign of the two symbol terms of the branch metric, for the transitions
+// from p0 = n >> 1 (first half) and from p1 = (n + nstates) >> 1
+	signs = new short[4 * nstates];
+	for (int n = 0; n < nstates; n++) {
+		signs[n]               = (output[n] & 1) ? -1 : 1;
+		signs[n + nstates]     = (output[n] & 2) ? -1 : 1;
+		signs[n + 2 * nstates] = (output[n + nstates] & 1) ? -1 : 1;
+		signs[n + 3 * nstates] = (output[n + nstates] & 2) ? -1 : 1;
+	}
+
+	metbuf = new short[PATHMEM * nstates];
 	for (int i = 0; i < PATHMEM; i++) {
-		metrics[i] = new int[nstates];
-		history[i] = new int[nstates];
-		sequence[i] = 0;
-		for (int j = 0; j < nstates; j++)
-			metrics[i][j] = history[i][j] = 0;
+		metrics[i] = metbuf + i * nstates;
+		decisions[i] = new unsigned int[nwords];
 	}
 	for (int i = 0; i < 256; i++) {
 		mettab[0][i] = 128 - i;
@@ -63,19 +77,22 @@ viterbi::viterbi(int k, int poly1, int poly2)
 viterbi::~viterbi()
 {
 	if (output) delete [] output;
-	for (int i = 0; i < PATHMEM; i++) {
-		if (metrics[i]) delete [] metrics[i];
-		if (history[i]) delete [] history[i];
-	}
+	delete [] signs;
+	delete [] metbuf;
+	for (int i = 0; i < PATHMEM; i++)
+		delete [] decisions[i];
 }
 
 void viterbi::reset()
 {
+	memset(metbuf, 0, PATHMEM * nstates * sizeof(short));
 	for (int i = 0; i < PATHMEM; i++) {
-		memset(metrics[i], 0, nstates * sizeof(int));
-		memset(history[i], 0, nstates * sizeof(int));
+		memset(decisions[i], 0, nwords * sizeof(unsigned int));
+		norm[i] = 0;
+		sequence[i] = 0;
 	}
 	ptr = 0;
+	filled = 0;
 }
 
 int viterbi::settraceback(int trace) {
@@ -115,13 +132,19 @@ int viterbi::traceback(int *metric)
 
 	for (int i = 0; i < _traceback; i++) {
 		unsigned int prev = (p - 1) % PATHMEM;
-
-		sequence[prev] = history[p][sequence[p]];
+		int s = sequence[p];
+		int bit = (decisions[p][s >> 5] >> (s & 31)) & 1;
+
+// slots not yet written since reset() lead back to state 0
+		if (p < filled)
+			sequence[prev] = (s >> 1) | (bit ? topbit : 0);
+		else
+			sequence[prev] = 0;
 		p = prev;
 	}
 
 	if (metric)
-		*metric = metrics[p][sequence[p]];
+		*metric = metrics[p][sequence[p]] + norm[p];
 
 // Decode 'chunksize' bits
 	for (int i = 0; i < _chunksize; i++) {
@@ -131,11 +154,74 @@ int viterbi::traceback(int *metric)
 	}
 
 	if (metric)
-		*metric = metrics[p][sequence[p]] - *metric;
+		*metric = metrics[p][sequence[p]] + norm[p] - *metric;
 
 	return c;
 }
 
+// Add-compare-select for all states, one at a time.  The new metrics are
+// offset by the previous metric of state 0.
+void viterbi::acs_scalar(const short *prev, short *curr, unsigned int *dec, const int *met)
+{
+	int ref = prev[0];
+
+	memset(dec, 0, nwords * sizeof(unsigned int));
+	for (int n = 0; n < nstates; n++) {
+		int p0, p1, m0, m1;
+
+		p0 = n >> 1;
+		p1 = p0 + topbit;
+
+		m0 = prev[p0] + met[output[n]];
+		m1 = prev[p1] + met[output[n + nstates]];
+
+		if (m0 > m1)
+			curr[n] = m0 - ref;
+		else {
+			curr[n] = m1 - ref;
+			dec[n >> 5] |= 1U << (n & 31);
+		}
+	}
+}
+
+#ifdef __SSE2__
+// Same as acs_scalar, eight states per iteration; nstates must be a
+// multiple of 8.  a and b are the branch metric terms of the two symbols.
+void viterbi::acs_sse2(const short *prev, short *curr, unsigned int *dec, int a, int b)
+{
+	__m128i ref = _mm_set1_epi16(prev[0]);
+	__m128i va = _mm_set1_epi16(a);
+	__m128i vb = _mm_set1_epi16(b);
+	const short *sa0 = signs, *sb0 = signs + nstates;
+	const short *sa1 = signs + 2 * nstates, *sb1 = signs + 3 * nstates;
+
+	memset(dec, 0, nwords * sizeof(unsigned int));
+	for (int n = 0, j = 0; n < nstates; n += 8, j++) {
+// predecessors n >> 1 are four consecutive states, each used twice
+		__m128i q0 = _mm_loadl_epi64((const __m128i *)(prev + (n >> 1)));
+		__m128i q1 = _mm_loadl_epi64((const __m128i *)(prev + (n >> 1) + topbit));
+		q0 = _mm_unpacklo_epi16(q0, q0);
+		q1 = _mm_unpacklo_epi16(q1, q1);
+
+		__m128i bm0 = _mm_add_epi16(
+			_mm_mullo_epi16(va, _mm_loadu_si128((const __m128i *)(sa0 + n))),
+			_mm_mullo_epi16(vb, _mm_loadu_si128((const __m128i *)(sb0 + n))));
+		__m128i bm1 = _mm_add_epi16(
+			_mm_mullo_epi16(va, _mm_loadu_si128((const __m128i *)(sa1 + n))),
+			_mm_mullo_epi16(vb, _mm_loadu_si128((const __m128i *)(sb1 + n))));
+
+		__m128i m0 = _mm_add_epi16(q0, bm0);
+		__m128i m1 = _mm_add_epi16(q1, bm1);
+		__m128i gt = _mm_cmpgt_epi16(m0, m1);
+
+		_mm_storeu_si128((__m128i *)(curr + n), _mm_sub_epi16(_mm_max_epi16(m0, m1), ref));
+
+		unsigned int bits = ~_mm_movemask_epi8(_mm_packs_epi16(gt, gt)) & 0xff;
+		dec[j >> 2] |= bits << (8 * (j & 3));
+	}
+}
+#endif
+
 int viterbi::decode(unsigned char *sym, int *metric)
 {
 	unsigned int currptr, prevptr;
@@ -155,48 +241,53 @@ int viterbi::decode(unsigned char *sym, int *metric)
 //	met[2] = sym[1] - sym[0];
 //	met[3] = sym[0] + sym[1] - 256;
 
-	for (int n = 0; n < nstates; n++) {
-		int p0, p1, s0, s1, m0, m1;
-
-		m0 = 0;
-		m1 = 0;
-		s0 = n;
-		s1 = n + nstates;
-
-		p0 = s0 >> 1;
-		p1 = s1 >> 1;
-
-		m0 = metrics[prevptr][p0] + met[output[s0]];
-		m1 = metrics[prevptr][p1] + met[output[s1]];
-
-		if (m0 > m1) {
-			metrics[currptr][n] = m0;
-			history[currptr][n] = p0;
-		} else {
-			metrics[currptr][n] = m1;
-			history[currptr][n] = p1;
-		}
-	}
+	norm[currptr] = norm[prevptr] + metrics[prevptr][0];
+#ifdef __SSE2__
+	if ((nstates & 7) == 0)
+		acs_sse2(metrics[prevptr], metrics[currptr], decisions[currptr],
+			 mettab[0][sym[0]], mettab[0][sym[1]]);
+	else
+#endif
+		acs_scalar(metrics[prevptr], metrics[currptr], decisions[currptr], met);
 
 	ptr = (ptr + 1) % PATHMEM;
+	if (filled < PATHMEM)
+		filled++;
 
 	if ((ptr % _chunksize) == 0)
 		return traceback(metric);
 
-	if (metrics[currptr][0] > INT_MAX / 2) {
+	int m = metrics[currptr][0] + norm[currptr];
+	if (m > INT_MAX / 2) {
 		for (int i = 0; i < PATHMEM; i++)
-			for (int j = 0; j < nstates; j++)
-				metrics[i][j] -= INT_MAX / 2;
+			norm[i] -= INT_MAX / 2;
 	}
-	if (metrics[currptr][0] < INT_MIN / 2) {
+	if (m < INT_MIN / 2) {
 		for (int i = 0; i < PATHMEM; i++)
-			for (int j = 0; j < nstates; j++)
-				metrics[i][j] += INT_MIN / 2;
+			norm[i] += INT_MIN / 2;
 	}
 
 	return -1;
 }
 
+// Decode npairs symbol pairs from syms.  Every decoded chunk is stored in
+// out[], and its metric in metric[] if not NULL.  Returns the number of
+// chunks stored, at most npairs / chunksize + 1.
+int viterbi::decode_block(const unsigned char *syms, int npairs, int *out, int *metric)
+{
+	int n = 0, c;
+	unsigned char sym[2];
+
+	for (int i = 0; i < npairs; i++, syms += 2) {
+		sym[0] = syms[0];
+		sym[1] = syms[1];
+		if ((c = decode(sym, metric ? metric + n : NULL)) != -1)
+			out[n++] = c;
+	}
+
+	return n;
+}
+
 /* ---------------------------------------------------------------------- */
 #include <iostream>
 encoder::encoder(int k, int poly1, int poly2)
@@ -51,6 +51,18 @@ string TXIDENT		= "TX: Watchdog %d";
 
 //bool bPoll = false;
 
+unsigned short Ccrc16::table[256];
+
+void Ccrc16::init_table()
+{
+	for (int i = 0; i < 256; i++) {
+		unsigned int crc = i;
+		for (int j = 0; j < 8; j++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+		table[i] = crc;
+	}
+}
+
 string arq::upcase(string s)
 {
 	for (size_t i = 0; i < s.length(); i++)
@@ -136,7 +148,7 @@ arq::arq()
 	TxMissing.clear();
 	TxPending.clear();
 
-	RxPending.clear();
+	RxHave = 0;
 
  	arqstop = false;
  	
@@ -169,6 +181,8 @@ void arq::resetTx()
 	TxBlocks.clear();
 	TxPending.clear();
 	TxTextQueue.clear();
+	for (int i = 0; i < MAXCOUNT; i++)
+		TxFrame[i].clear();
 //	UrMissing.clear();
 }
 
@@ -179,7 +193,7 @@ void arq::resetRx()
 	lastRxChar = 0;
 	EndHeader = MAXCOUNT - 1;		// Last  I received o.k.
 	GoodHeader = MAXCOUNT - 1;		// Last Header I received conseq. o.k, 1st in send queue
-	RxPending.clear();
+	RxHave = 0;
 	MissingRxBlocks = "";
 }
 
@@ -212,8 +226,8 @@ void arq::newblocknumber()
 // Checksum of header + Header
 string arq::checksum(string &s)
 {
-	framecrc.reset();
-	return framecrc.scrc16(s);
+	framecrc.crc16(s.data(), s.length());
+	return framecrc.hex();
 }
 
 // Start header when MyStreamID has been assigned
@@ -238,7 +252,7 @@ void arq::UnkHeader()
 
 char crlf[3] = "  ";
 
-void arq::addToTxQue(string s)
+void arq::addToTxQue(const string &s)
 {
 //	TxTextQueue += "\r\n";
 	crlf[0] = 0x0D;
@@ -575,16 +589,21 @@ void arq::pollFrame()
 }
 
 // Text frame
-void arq::textFrame(cTxtBlk block)
+// assembled once into the block's slot; repeats send the slot as is
+void arq::textFrame(cTxtBlk &block)
 {
-	IdHeader();
-	Frame = Header;
-	Frame += (block.nbr() + 0x20);
-	Frame.append(block.text());
-	Frame.append(checksum(Frame));
-	Frame += SOH;
+	string &slot = TxFrame[block.nbr()];
 
-	addToTxQue(Frame);
+	IdHeader();
+	slot.reserve(Header.length() + Bufferlength + 6);
+	slot = Header;
+	slot += (block.nbr() + 0x20);
+	slot.append(block.text());
+	framecrc.crc16(slot.data(), slot.length());
+	slot.append(framecrc.hex(), 4);
+	slot += SOH;
+
+	addToTxQue(slot);
 }
 
 //=====================================================================
@@ -792,40 +811,31 @@ void arq::parseSTATUS()
 		UrGoodHeader = rcvPayload[1] - 0x20;	// Other station's Good Header
 		UrEndHeader = rcvPayload[2] - 0x20;		// Other station's last received Header
 
-		size_t nummissing = rcvPayload.length() - 3;
-		vector<int> missing;
-// append those reported missing
-		if (nummissing > 0)
-			for (size_t i = 0; i < nummissing; i++)
-				missing.push_back(rcvPayload[i+3] - 0x20);
-// append those not reported missing from UrEndHeader to LastHeader
-		if (UrEndHeader != LastHeader) {
-			int m = UrEndHeader + 1;
-			if (m > MAXCOUNT) m -= MAXCOUNT;
+		bool missing[MAXCOUNT] = { false };
+// those reported missing
+		for (size_t i = 3; i < rcvPayload.length(); i++) {
+			int m = rcvPayload[i] - 0x20;
+			if (m >= 0 && m < MAXCOUNT)
+				missing[m] = true;
+		}
+// and those not reported missing from UrEndHeader to LastHeader
+		if (UrEndHeader >= 0 && UrEndHeader < MAXCOUNT &&
+		    UrEndHeader != LastHeader) {
+			int m = (UrEndHeader + 1) % MAXCOUNT;
 			while (m != LastHeader) {
-				missing.push_back(m);
-				m++;
-				if (m > MAXCOUNT) m -= MAXCOUNT;
+				missing[m] = true;
+				m = (m + 1) % MAXCOUNT;
 			}
-			missing.push_back(LastHeader);
+			missing[LastHeader] = true;
 		}
-	
-		if (missing.empty())
-			TxMissing.clear();		
-		
-		if (TxMissing.empty() == false) {
-			list<cTxtBlk> keep;
-			list<cTxtBlk>::iterator p = TxMissing.begin();
-			while (p != TxMissing.end()) {
-				for (size_t n = 0; n < missing.size(); n++) {
-					if (p->nbr() == missing[n]) {
-						keep.push_back(*p);
-						break;
-					}
-				}
+
+// only the blocks still missing are repeated
+		list<int>::iterator p = TxMissing.begin();
+		while (p != TxMissing.end()) {
+			if (missing[*p])
 				p++;
-			}
-			TxMissing = keep;
+			else
+				p = TxMissing.erase(p);
 		}
 	}
 
@@ -880,79 +890,54 @@ void arq::parsePOLL()
 	printSTATUS(RXPOLL, 5.0);
 }
 
+// received blocks go to their slot; RxHave marks the occupied slots
+// blocks are numbered modulo MAXCOUNT, counted here from GoodHeader
 void arq::parseDATA()
 {
-	vector<cTxtBlk>::iterator p1, p2;
-	int n1, n2;
-	
 	if (LinkState < CONNECTED) return; // do not respond if DOWN or TIMEDOUT
-	
-	for (p1 = RxPending.begin(); p1 < RxPending.end(); p1++) 
-		if (blknbr == p1->nbr()) {
-			return;
-		}
-		
+
+	if (blknbr < 0 || blknbr >= MAXCOUNT)
+		return;
+	int dist = (blknbr - GoodHeader + MAXCOUNT) % MAXCOUNT;
+// a repeat of a block already delivered
+	if (dist == 0 || dist > MAXWINDOW)
+		return;
+	if (RxHave & (1ULL << blknbr))
+		return;
+
 	char szStatus[80];
 	snprintf(szStatus, sizeof(szStatus),"RX: data block %d", blknbr);
 	printSTATUS(szStatus, 5.0);
-			
-	cTxtBlk tempblk(blknbr, rcvPayload);
-	RxPending.push_back (tempblk);
-
-	for (p1 = RxPending.begin(); p1 < RxPending.end() - 1; p1++) {
-		n1 = p1->nbr();
-		if (n1 < GoodHeader) n1 += MAXCOUNT;
-		for (p2 = p1 + 1; p2 < RxPending.end(); p2++) {
-			n2 = p2->nbr();
-			if (n2 < GoodHeader) n2 += MAXCOUNT;
-			if (n2 < n1) {
-				tempblk = *p1;
-				*p1 = *p2;
-				*p2 = tempblk;
-			}
-		}
+
+	RxBlock[blknbr] = rcvPayload;
+	RxHave |= 1ULL << blknbr;
+
+// deliver the blocks that are consecutive to GoodHeader
+	int next = (GoodHeader + 1) % MAXCOUNT;
+	while (RxHave & (1ULL << next)) {
+		RxTextQueue.append(RxBlock[next]);
+		if (printRX) printRX(RxBlock[next]);
+		RxHave &= ~(1ULL << next);
+		GoodHeader = next;
+		next = (next + 1) % MAXCOUNT;
 	}
+
 // compute new EndHeader
 	EndHeader = GoodHeader;
-	if (!RxPending.empty()) {
-		p1 = RxPending.end() - 1;
-		EndHeader = p1->nbr();
-	}
-
-// add RxPending blocks that are consecutive to GoodHeader
-	p1 = RxPending.begin();	
-	while (!RxPending.empty()) {
-		if ((p1->nbr() != (GoodHeader +1) % MAXCOUNT))
+	for (int i = MAXWINDOW; i > 0; i--) {
+		int n = (GoodHeader + i) % MAXCOUNT;
+		if (RxHave & (1ULL << n)) {
+			EndHeader = n;
 			break;
-		RxTextQueue.append(p1->text());
-		GoodHeader = p1->nbr();
-		if (printRX) printRX(p1->text());
-		RxPending.erase(p1);
-		p1 = RxPending.begin();
+		}
 	}
 
 	MissingRxBlocks = "";
-
-	if (RxPending.empty())
+	if (EndHeader == GoodHeader)
 		return;
-
-	int start = (GoodHeader + 1)%MAXCOUNT;
-	int end = (EndHeader + 1)%MAXCOUNT;
-	int test;
-	bool ok;
-	if (end < start) end += MAXCOUNT;
-	for (int i = start; i < end; i++) {
-		test = (i % MAXCOUNT);
-		ok = false;
-		for (p1 = RxPending.begin(); p1 < RxPending.end(); p1++) {
-			if (test == p1->nbr()) {
-				ok = true;
-				break;
-			}
-		}
-		if (!ok)
-			MissingRxBlocks += test + 0x20;
-	}
+	for (int n = (GoodHeader + 1) % MAXCOUNT; n != EndHeader; n = (n + 1) % MAXCOUNT)
+		if (!(RxHave & (1ULL << n)))
+			MissingRxBlocks += n + 0x20;
 }
 
 bool arq::isUrcall()
@@ -974,15 +959,14 @@ bool arq::isUrcall()
 //    n  valid frame
 //       rcvPayload will contain the valid payload
 //
-int arq::parseFrame(string txt)
+int arq::parseFrame(const string &txt)
 {
 	if ( txt.length() < 8 ) {
 		return -1; // not a valid frame
 	}
-	Ccrc16 testcrc;
 	size_t len = txt.length();
 
-	rcvPayload = txt.substr(4, len - 8);
+	rcvPayload.assign(txt, 4, len - 8);
 	fID = txt[3];
 
 // treat unproto TALK as a special case
@@ -996,9 +980,10 @@ int arq::parseFrame(string txt)
 		return -1;
 	}
 	
-	string sRcvdCRC = testcrc.scrc16( txt.substr(0, len - 4));
+// crc over the frame in place
+	framecrc.crc16(txt.data(), len - 4);
 
-	if (sRcvdCRC != txt.substr(len - 4) ) {
+	if (txt.compare(len - 4, 4, framecrc.hex()) != 0) {
 		if (printRX_DEBUG)
 			printRX_DEBUG("CRC failed\n");
 		return -1; // failed CRC test
@@ -1172,22 +1157,24 @@ void arq::sendblocks()
 	int framecount = 0;
 	cTxtBlk tempblk;
 	
+// repeat only what the other station reported missing
 	if (TxMissing.empty() == false) {
-		list<cTxtBlk>::iterator p = TxMissing.begin();
+		list<int>::iterator p = TxMissing.begin();
 		while (p != TxMissing.end()) {
-			textFrame(*p);
+			addToTxQue(TxFrame[*p]);
 			p++;
 			framecount++;
 		}
 	}
 	missedblks = framecount;
+// new blocks, keeping no more than MAXWINDOW beyond UrGoodHeader
 	if (!TxBlocks.empty()) {
 		while (TxBlocks.empty() == false && framecount < maxheaders) {
 			tempblk = TxBlocks.front();
-			if ((tempblk.nbr() + 2)%MAXCOUNT == UrGoodHeader)
+			if ((tempblk.nbr() - UrGoodHeader + MAXCOUNT) % MAXCOUNT > MAXWINDOW)
 				break;
 			TxBlocks.pop_front();
-			TxMissing.push_back(tempblk);
+			TxMissing.push_back(tempblk.nbr());
 			TxPending.push_back(tempblk);
 			textFrame(tempblk);
 			LastHeader = tempblk.nbr();
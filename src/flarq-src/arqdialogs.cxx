@@ -319,6 +319,13 @@ static void cb_spnBcnInterval(Fl_Spinner2* o, void*) {
 cbSetConfig();
 }
 
+Fl_Spinner2 *spnMaxHeaders=(Fl_Spinner2 *)0;
+
+static void cb_spnMaxHeaders(Fl_Spinner2* o, void*) {
+  maxheaders = (int)o->value();
+cbSetConfig();
+}
+
 Fl_Button *btnOK=(Fl_Button *)0;
 
 static void cb_btnOK(Fl_Button*, void*) {
@@ -334,7 +341,7 @@ cbSetConfig();
 
 Fl_Double_Window* arq_configure() {
   Fl_Double_Window* w;
-  { Fl_Double_Window* o = new Fl_Double_Window(480, 162, "Configure flarq");
+  { Fl_Double_Window* o = new Fl_Double_Window(480, 186, "Configure flarq");
     w = o;
     { Fl_Input2* o = txtMyCall = new Fl_Input2(98, 13, 150, 24, "My Call:");
       txtMyCall->box(FL_DOWN_BOX);
@@ -449,6 +456,24 @@ Fl_Double_Window* arq_configure() {
       o->step(30);
       o->value(bcnInterval);
     } // Fl_Spinner2* spnBcnInterval
+    { Fl_Spinner2* o = spnMaxHeaders = new Fl_Spinner2(121, 154, 70, 22, "Blocks per turn:");
+      spnMaxHeaders->tooltip("Most data blocks sent in one transmission");
+      spnMaxHeaders->box(FL_NO_BOX);
+      spnMaxHeaders->color(FL_BACKGROUND_COLOR);
+      spnMaxHeaders->selection_color(FL_BACKGROUND_COLOR);
+      spnMaxHeaders->labeltype(FL_NORMAL_LABEL);
+      spnMaxHeaders->labelfont(0);
+      spnMaxHeaders->labelsize(14);
+      spnMaxHeaders->labelcolor(FL_FOREGROUND_COLOR);
+      spnMaxHeaders->value(16);
+      spnMaxHeaders->callback((Fl_Callback*)cb_spnMaxHeaders);
+      spnMaxHeaders->align(Fl_Align(FL_ALIGN_LEFT));
+      spnMaxHeaders->when(FL_WHEN_RELEASE);
+      o->minimum(1);
+      o->maximum(32);
+      o->step(1);
+      o->value(maxheaders);
+    } // Fl_Spinner2* spnMaxHeaders
     { btnOK = new Fl_Button(406, 126, 62, 24, "Ok");
       btnOK->callback((Fl_Callback*)cb_btnOK);
     } // Fl_Button* btnOK
@@ -193,6 +193,7 @@ int    iretries = 5;
 long   iwaittime = 10000;
 long   itimeout = 60000;
 int	   bcnInterval = 30;
+int    maxheaders = MAXHEADERS;
 bool   autobeacon = false;
 bool   beaconrcvd = false;
 
@@ -588,6 +589,7 @@ void initVals()
 	txdelay = digi_arq->getTxDelay();
 	iwaittime = digi_arq->getWaitTime();
 	bcnInterval = 30;
+	maxheaders = digi_arq->getMaxHeaders();
 	beacontext = "";
 	cbMenuConfig();
 	digi_arq->myCall(MyCall.c_str());
@@ -633,12 +635,16 @@ void readConfig()
 			configfile.ignore();
 			configfile.getline(tempstr, 200);
 			beacontext = tempstr;
+// blocks per turn, absent from older config files
+			if (!(configfile >> maxheaders))
+				maxheaders = MAXHEADERS;
 			digi_arq->myCall(MyCall.c_str());
 			digi_arq->setExponent(exponent);
 			digi_arq->setRetries(iretries);
 			digi_arq->setTimeout(itimeout);
 			digi_arq->setTxDelay(txdelay);
 			digi_arq->setWaitTime(iwaittime);
+			digi_arq->setMaxHeaders(maxheaders);
 		}
 		configfile.close();
 	} else
@@ -669,6 +675,7 @@ void saveConfig()
 		configfile << mainW << endl;
 		configfile << mainH << endl;
 		configfile << beacontext.c_str() << endl;
+		configfile << maxheaders << endl;
 		configfile.close();
 	}
 }
@@ -680,6 +687,7 @@ void cbSetConfig()
 	digi_arq->setTimeout(itimeout);
 	digi_arq->setTxDelay(txdelay);
 	digi_arq->setWaitTime(iwaittime);
+	digi_arq->setMaxHeaders(maxheaders);
 }
 
 void closeConfig()
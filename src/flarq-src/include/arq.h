@@ -76,8 +76,9 @@ using namespace std;
 #define EOT			0X04
 //=====================================================================
 //ARQ defaults
-#define	MAXHEADERS  	8	// Max. number of missing blocks
+#define	MAXHEADERS  	16	// Max. number of blocks sent per turn
 #define MAXCOUNT		64  // DO NOT CHANGE THIS CONSTANT
+#define MAXWINDOW		(MAXCOUNT / 2)	// Max. blocks in flight, new & repeats
 #define EXPONENT		7	// Bufferlength = 2 ^ EXPONENT = 128
 //=====================================================================
 //link timing defaults
@@ -107,39 +108,55 @@ extern char *ARQASCII[];
 
 // crc 16 cycle redundancy check sum for data block integrity
 
+// table driven, one lookup per character; the table is shared by all instances
 class Ccrc16 {
 private:
 	unsigned int crcval;
 	char ss[5];
+	static unsigned short table[256];
+	static void init_table();
 public:
-	Ccrc16() { crcval = 0xFFFF; }
+	Ccrc16() { crcval = 0xFFFF; if (!table[1]) init_table(); }
 	~Ccrc16() {};
 	void reset() { crcval = 0xFFFF;}
 	unsigned int val() {return crcval;}
-	string sval() {
-		snprintf(ss, sizeof(ss), "%04X", crcval);
+	// same text as snprintf(ss, 5, "%04X", crcval), no allocation: a crc
+	// wider than 16 bits keeps only its 4 leading hex digits
+	const char *hex() {
+		static const char digits[] = "0123456789ABCDEF";
+		int shift = 0;
+		while ((crcval >> shift) > 0xFFFF)
+			shift += 4;
+		for (int i = 0; i < 4; i++)
+			ss[i] = digits[(crcval >> (shift + 12 - 4 * i)) & 0x0F];
+		ss[4] = 0;
 		return ss;
 	}
+	string sval() { return hex(); }
+	// the bit-wise original xor'ed in a plain char, so bytes >= 0x80 are
+	// sign extended into the upper bits where char is signed; that is on
+	// the wire and must be kept
 	void update(char c) {
-		crcval ^= c;
-        for (int i = 0; i < 8; ++i) {
-            if (crcval & 1)
-                crcval = (crcval >> 1) ^ 0xA001;
-            else
-                crcval = (crcval >> 1);
-        }
+		unsigned int x = crcval ^ c;
+		crcval = (x >> 8) ^ table[x & 0xFF];
+	}
+	void update(const char *p, size_t n) {
+		while (n--)
+			update(*p++);
 	}
 	unsigned int crc16(char c) { 
 		update(c); 
 		return crcval;
 	}
-	unsigned int crc16(string s) {
+	unsigned int crc16(const char *p, size_t n) {
 		reset();
-		for (size_t i = 0; i < s.length(); i++)
-			update(s[i]);
+		update(p, n);
 		return crcval;
 	}
-	string scrc16(string s) {
+	unsigned int crc16(const string &s) {
+		return crc16(s.data(), s.length());
+	}
+	string scrc16(const string &s) {
 		crc16(s);
 		return sval();
 	}
@@ -195,6 +212,11 @@ private:
 	char	lastRxChar;
 	bool	TXflag;
 
+// block slots, indexed by block number
+	string	TxFrame[MAXCOUNT];		// assembled text frames, reused for repeats
+	string	RxBlock[MAXCOUNT];		// received blocks not yet consecutive
+	unsigned long long RxHave;		// bit n set if RxBlock[n] is valid
+
 	int		Sessionnumber;
 	int		Bufferlength;
 	int		maxheaders;
@@ -242,10 +264,9 @@ private:
 
 	vector<int>	MyMissing;				// missing Rx blocks
 	string MissingRxBlocks;
-	vector<cTxtBlk> RxPending;			// RxPending Rx blocks (not consecutive)
-	
+
 	list<cTxtBlk> TxBlocks;				// fifo of transmit buffers
-	list<cTxtBlk> TxMissing;			// fifo of sent; RxPending Status report
+	list<int> TxMissing;				// block numbers sent; pending Status report
 	list<cTxtBlk> TxPending;			// fifo of transmitted buffers pending print
 
 // Ur status
@@ -290,10 +311,10 @@ private:
 	void	abortFrame();
 	void	ackAbortFrame();
 	void	beaconFrame(string txt);
-	void	textFrame(cTxtBlk block);
+	void	textFrame(cTxtBlk &block);
 	void    talkFrame(string txt);
 	
-	void	addToTxQue(string s);
+	void	addToTxQue(const string &s);
 	
 	void	sendblocks();
 	void	transmitdata();
@@ -315,7 +336,7 @@ private:
 	void	parseDATA();
 	void	parseTALK();
 
-	int		parseFrame(string txt);
+	int		parseFrame(const string &txt);
 	
 // external functions called by arq class	
 	void	(*sendfnc)(const string& s);
@@ -360,7 +381,9 @@ public:
 	void	setPrintTX_DEBUG (void (*f)(string s)) {printTX_DEBUG = f;}
 	void	setPrintSTATUS (void (*f)(string s, double disptime)) { printSTATUS = f;}
 	
-	void	setMaxHeaders( int mh ) { maxheaders = mh; }
+	void	setMaxHeaders( int mh ) {
+				maxheaders = mh < 1 ? 1 : mh > MAXWINDOW ? MAXWINDOW : mh; }
+	int		getMaxHeaders() { return maxheaders; }
 	void	setExponent( int exp ) { exponent = exp; setBufferlength(); }
 	int		getExponent() { return (int) exponent;}
 	void	setWaitTime( int rtime ) { RetryTime = rtime; baseRetryTime = rtime; }
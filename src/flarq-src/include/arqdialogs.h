@@ -52,6 +52,7 @@ extern Fl_Spinner2 *spnWaitTime;
 extern Fl_Spinner2 *spnTimeout;
 extern Fl_Spinner2 *spnTxDelay;
 extern Fl_Spinner2 *spnBcnInterval;
+extern Fl_Spinner2 *spnMaxHeaders;
 extern Fl_Button *btnOK;
 extern Fl_ComboBox *choiceBlockSize;
 Fl_Double_Window* arq_configure();
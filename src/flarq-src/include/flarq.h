@@ -46,6 +46,7 @@ extern int		iretries;
 extern long		iwaittime;
 extern long		itimeout;
 extern int		bcnInterval;
+extern int		maxheaders;
 
 extern void cb_SaveComposeMail();
 extern void cb_CancelComposeMail();
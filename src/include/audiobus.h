@@ -0,0 +1,203 @@
+// ----------------------------------------------------------------------------
+// audiobus.h  --  multi-consumer audio block bus
+//
+// This file is part of fldigi.
+//
+// Fldigi is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Fldigi is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with fldigi.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+// A single producer publishes fixed-size sample blocks, numbered by a
+// sequence counter, into a window of the last `slots' blocks.  Any number of
+// consumers acquire blocks by sequence number; an acquired block is reference
+// counted and is never reused by the producer until it has been released, so
+// a consumer running on another thread (e.g. the waterfall, through a qrunner
+// request) can never see its samples overwritten.  A consumer that falls more
+// than `slots' blocks behind loses the oldest blocks and is told how many.
+//
+// The blocks come from a fixed pool with some spares beyond the window, so
+// the producer can keep publishing while consumers hold a few old blocks.  If
+// every spare is held the producer drops the new block and counts it in
+// dropped().
+
+#ifndef AUDIOBUS_H
+#define AUDIOBUS_H
+
+#include <cassert>
+#include <cstring>
+#include "util.h"
+
+template <typename T>
+class audio_bus
+{
+public:
+	struct block {
+		volatile unsigned long seq;
+		volatile int refs;
+		size_t len;
+		int samplerate;
+		T* data;
+	};
+
+	// Per-consumer read position
+	class reader
+	{
+		audio_bus& bus;
+		unsigned long next;
+		unsigned long lost;
+	public:
+		reader(audio_bus& b) : bus(b), next(b.head()), lost(0) { }
+		// Acquire the next block, or return 0 if none has been published
+		// yet.  The caller must release() the block when done with it.
+		block* get(void)
+		{
+			for (;;) {
+				if (next == bus.head())
+					return 0;
+				if (next < bus.tail()) {
+					lost += bus.tail() - next;
+					next = bus.tail();
+				}
+				block* b = bus.acquire(next);
+				if (b) {
+					next++;
+					return b;
+				}
+				// overwritten while we were looking at it
+				lost++;
+				next++;
+			}
+		}
+		void release(block* b) { bus.release(b); }
+		// Move to the oldest block still held by the bus
+		void rewind(void) { next = bus.tail(); }
+		// Skip to the newest published block
+		void sync(void) { next = bus.head(); }
+		bool at_head(void) const { return next == bus.head(); }
+		unsigned long overruns(void) const { return lost; }
+	};
+
+public:
+	audio_bus(size_t slots, size_t spares, size_t blocksize)
+		: nslots(slots), npool(slots + spares), bsize(blocksize), seq(0), start(0), ndropped(0)
+	{
+		assert(powerof2(slots));
+		assert(spares > 0);
+
+		window = new block* volatile[nslots];
+		pool = new block[npool];
+		samples = new T[npool * bsize];
+		for (size_t i = 0; i < npool; i++) {
+			pool[i].seq = ~0UL;
+			pool[i].refs = 0;
+			pool[i].len = 0;
+			pool[i].samplerate = 0;
+			pool[i].data = samples + i * bsize;
+		}
+		for (size_t i = 0; i < nslots; i++)
+			window[i] = 0;
+		hint = 0;
+	}
+	~audio_bus()
+	{
+		delete [] window;
+		delete [] pool;
+		delete [] samples;
+	}
+
+	// Producer: get a free block to fill in.  Returns 0 if every block of
+	// the pool is either in the window or held by a consumer.
+	block* claim(void)
+	{
+		for (size_t n = 0; n < npool; n++) {
+			block* b = &pool[hint];
+			if (++hint == npool)
+				hint = 0;
+			if (__sync_bool_compare_and_swap(&b->refs, 0, 1)) {
+				b->seq = ~0UL;
+				b->len = 0;
+				return b;
+			}
+		}
+		ndropped++;
+		return 0;
+	}
+	// Producer: publish a block obtained from claim().  The window keeps
+	// the reference taken by claim() until the slot is reused.
+	void publish(block* b)
+	{
+		size_t slot = seq & (nslots - 1);
+
+		b->seq = seq;
+		write_memory_barrier();
+		block* old = window[slot];
+		window[slot] = b;
+		write_memory_barrier();
+		seq++;
+		if (old)
+			release(old);
+	}
+	// Forget all published blocks, e.g. when switching to transmit
+	void reset(void)
+	{
+		start = seq;
+	}
+
+	// Consumer: reference the block with sequence number s, or return 0
+	// if it is no longer (or not yet) in the window.
+	block* acquire(unsigned long s)
+	{
+		read_memory_barrier();
+		if (s >= seq || s < tail())
+			return 0;
+		size_t slot = s & (nslots - 1);
+		block* b = window[slot];
+		if (!b)
+			return 0;
+		__sync_fetch_and_add(&b->refs, 1);
+		// The block cannot be reclaimed any more; check that it is
+		// still the one published under s
+		read_memory_barrier();
+		if (window[slot] != b || b->seq != s) {
+			release(b);
+			return 0;
+		}
+		return b;
+	}
+	void release(block* b)
+	{
+		__sync_fetch_and_sub(&b->refs, 1);
+	}
+
+	unsigned long head(void) const { return seq; }
+	unsigned long tail(void) const
+	{
+		unsigned long s = seq;
+		return s - start > nslots ? s - nslots : start;
+	}
+	size_t slots(void) const { return nslots; }
+	size_t blocksize(void) const { return bsize; }
+	unsigned long dropped(void) const { return ndropped; }
+
+private:
+	size_t nslots, npool, bsize;
+	block* volatile* window;
+	block* pool;
+	T* samples;
+	size_t hint;
+	volatile unsigned long seq;
+	volatile unsigned long start;
+	unsigned long ndropped;
+};
+
+#endif // AUDIOBUS_H
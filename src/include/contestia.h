@@ -58,7 +58,7 @@ private:
 
 	int			preamblesent;
 	int			postamblesent;
-	double		preamblephase;
+	oscillator	preambleosc;
 
 	double		txbasefreq;
 	double		tone_midfreq;
@@ -67,7 +67,6 @@ private:
 	double		ampshape[SR4];
 	double		tonebuff[TONE_DURATION];
 
-	double		nco(double freq);
 	void		send_tones();
 	
 public:
@@ -48,6 +48,7 @@
 //#define CW_FIRLEN   122      
 //#define CW_FIRLEN	  256
 //#define CW_FIRLEN   512
+#define CW_DECLEN   256
 // Limits on values of CW send and timing parameters 
 //#define	CW_MIN_SPEED		5	// Lowest WPM allowed 
 //#define	CW_MAX_SPEED		100	// Highest WPM allowed 
@@ -109,8 +110,8 @@ protected:
 	int			symbollen;		// length of a dot in sound samples (tx)
 	int			fsymlen;        	// length of extra interelement space (farnsworth)
 	double		phaseacc;		// used by NCO for rx/tx tones
-	double		FFTphase;
-	double		FIRphase;
+	oscillator	FFTosc;			// rx mixers
+	oscillator	FIRosc;
 	double		FFTvalue;
 	double		FIRvalue;
 	unsigned int	smpl_ctr;		// sample counter for timing cw rx
@@ -124,7 +125,8 @@ protected:
 	double		lower_threshold;
 
 	C_FIR_filter	*hilbert;   // Hilbert filter precedes sinc filter
-	fftfilt			*cw_FFT_filter; // sinc / matched filter
+	C_FIR_filter	*cw_decimator;	// anti-alias filter ahead of cw_FFT_filter
+	fftfilt			*cw_FFT_filter; // sinc / matched filter, at samplerate / DEC_RATIO
 	C_FIR_filter	*cw_FIR_filter; // linear phase finite impulse response filter
 
 	Cmovavg		*bitfilter;
@@ -165,7 +167,8 @@ protected:
 	int knum;					// number of samples on edges
 	int QSKshape;                   		// leading/trailing edge shape factor
 	double qskbuf[OUTBUFSIZE];			// signal array for qsk drive
-	double qskphase;				//
+	oscillator qskosc;				// qsk drive tone
+	oscillator txosc;				// transmitted tone
 	bool firstelement;
 	
 //	double *keyshape;				// array defining leading edge
@@ -188,8 +191,6 @@ protected:
 	double dot_tracking;
 	double dash_tracking;
 	
-	inline double nco(double freq);
-	inline double qsknco();
 	void	update_syncscope();
 	void    clear_syncscope();
 	void	update_Status();
@@ -0,0 +1,69 @@
+#ifndef DL_FLDIGI_EXTRACT_H
+#define DL_FLDIGI_EXTRACT_H
+
+#include <stddef.h>
+
+namespace dl_fldigi {
+namespace extract {
+
+enum { max_length = 256, max_fields = 32 };
+
+enum checksum_type
+{
+    CHECKSUM_NONE,
+    CHECKSUM_XOR,
+    CHECKSUM_CRC16
+};
+
+/* A UKHAS sentence, "$$payload,field,...*CHECKSUM\n", whose checksum has
+ * been verified. The fields are not copied: field[i] is the offset in text
+ * of the i-th field, which ends at the next ',' (or at body_end) */
+struct sentence
+{
+    char text[max_length];
+    unsigned short length, body_end;
+    unsigned short field[max_fields];
+    unsigned char fields;
+    enum checksum_type checksum;
+    bool baudot;
+
+    size_t field_length(int i) const
+    {
+        return (i + 1 < fields ? field[i + 1] - 1 : body_end) - field[i];
+    }
+};
+
+/* Scans decoded characters for sentences without allocating anything. Only
+ * sentences that pass their CRC16 or XOR checksum are returned */
+class scanner
+{
+    sentence cur;
+    bool active;
+    char last;
+    unsigned char sum_xor;
+    unsigned short sum_crc;
+    int star;
+
+    bool finish();
+    void abandon();
+
+public:
+    unsigned long rejected;
+
+    scanner() : active(false), last(0), rejected(0) {};
+
+    /* Returns true when a complete, valid sentence is in current() */
+    bool push(char c, bool baudot);
+    void skipped();
+    const sentence &current() const { return cur; }
+};
+
+/* Called by the modems, from the trx thread. Valid sentences are queued and
+ * handed to hbtint::extrmgr on the main thread; everything else stops here */
+void push(unsigned int c, bool baudot=false);
+void skipped(int n);
+
+} /* namespace extract */
+} /* namespace dl_fldigi */
+
+#endif /* DL_FLDIGI_EXTRACT_H */
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include "jsoncpp.h"
+#include "habitat/EZ.h"
 
 namespace dl_fldigi {
 namespace flights {
@@ -14,6 +15,14 @@ enum tracking_type_enum
     TRACKING_PAYLOAD
 };
 
+/* Parses the cache files without holding the Fl lock */
+class CacheThread : public EZ::SimpleThread
+{
+public:
+    std::vector<Json::Value> flights, payloads;
+    void *run();
+};
+
 extern bool downloaded_flights_once, downloaded_payloads_once;
 
 void init();
@@ -23,9 +23,17 @@ class GPSThread : public EZ::SimpleThread
     HANDLE handle;
 #endif
     int fd;
-    FILE *f;
     int wait_exp;
 
+    /* Partial line carried over between reads */
+    char buf[256];
+    size_t buf_len;
+
+    double last_altitude;
+    bool have_altitude;
+    double sum_latitude, sum_longitude, sum_altitude;
+    int sum_count;
+
     void prepare_signals();
     void send_signal();
     bool check_term();
@@ -38,8 +46,8 @@ class GPSThread : public EZ::SimpleThread
     void warning(const std::string &message);
 
     void read();
-    void update_ui(const string &time_str, double lat, double lon, double alt);
-    void upload(const string &time_str, double lat, double lon, double alt);
+    void parse(char *line);
+    void publish(const char *time_str, double lat, double lon, double alt);
 
 public:
     GPSThread(const std::string &d, int b, int r)
@@ -47,7 +55,10 @@ public:
 #ifdef __MINGW32__
           handle(INVALID_HANDLE_VALUE),
 #endif
-          fd(-1), f(NULL), wait_exp(0) {};
+          fd(-1), wait_exp(0), buf_len(0),
+          last_altitude(0), have_altitude(false),
+          sum_latitude(0), sum_longitude(0), sum_altitude(0),
+          sum_count(0) {};
     ~GPSThread() {};
 
     void *run();
@@ -6,6 +6,7 @@
 #include "jsoncpp.h"
 #include "habitat/Extractor.h"
 #include "habitat/UploaderThread.h"
+#include "dl_fldigi/spool.h"
 
 namespace dl_fldigi {
 namespace hbtint {
@@ -40,6 +41,16 @@ public:
     void *run();
 };
 
+class DSpoolThread : public spool::SpoolThread
+{
+public:
+    DSpoolThread(const std::string &filename)
+        : spool::SpoolThread(filename) {};
+
+    /* Modify run() to help us shutdown the thread */
+    void *run();
+};
+
 class DExtractorManager : public habitat::ExtractorManager
 {
 public:
@@ -52,6 +63,7 @@ public:
 
 extern DExtractorManager *extrmgr;
 extern DUploaderThread *uthr;
+extern DSpoolThread *sthr;
 
 void init();
 void start();
@@ -1,6 +1,9 @@
 #ifndef DL_FLDIGI_LOCATION_H
 #define DL_FLDIGI_LOCATION_H
 
+#include <string>
+#include <time.h>
+
 namespace dl_fldigi {
 namespace location {
 
@@ -18,10 +21,57 @@ extern double listener_latitude, listener_longitude, listener_altitude,
               balloon_latitude, balloon_longitude, balloon_altitude;
 extern bool listener_valid, balloon_valid;
 
+enum { track_history = 64, track_window = 8, max_tracked = 16 };
+
+struct track_point
+{
+    time_t time;
+    double latitude, longitude, altitude;
+};
+
+/* Every payload we have decoded a position from. The ascent rate and
+ * drift are a least squares fit over the last track_window points, and
+ * the fit is kept up to date as points are added rather than redone. */
+struct payload_track
+{
+    std::string name;
+    track_point history[track_history];
+    int head, count;
+
+    time_t epoch;
+    double sum_t, sum_tt, sum_alt, sum_t_alt, sum_lat, sum_t_lat,
+           sum_lon, sum_t_lon;
+
+    /* m/s, and degrees/s */
+    double ascent_rate, lat_rate, lon_rate;
+
+    /* Straight line extrapolation of the descent to the listener's
+     * altitude; only valid while descending */
+    bool landing_valid;
+    double landing_latitude, landing_longitude;
+    time_t landing_time;
+
+    /* From the listener: km, degrees, degrees */
+    bool range_valid;
+    double distance, bearing, elevation;
+
+    const track_point &latest() const
+    {
+        return history[(head + track_history - 1) % track_history];
+    }
+};
+
 void start();
 void update_distance_bearing();
 void update_stationary();
 
+/* Add a decoded position, and make it the balloon_* position shown */
+void payload_position(const std::string &name, double latitude,
+                      double longitude, double altitude);
+int tracked_count();
+const payload_track &tracked(int index);
+const payload_track *find_tracked(const std::string &name);
+
 } /* namespace location */
 } /* namespace dl_fldigi */
 
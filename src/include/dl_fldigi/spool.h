@@ -0,0 +1,93 @@
+#ifndef DL_FLDIGI_SPOOL_H
+#define DL_FLDIGI_SPOOL_H
+
+#include <string>
+#include <deque>
+#include <set>
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+#include "jsoncpp.h"
+#include "habitat/EZ.h"
+
+namespace habitat { class Uploader; }
+
+namespace dl_fldigi {
+namespace spool {
+
+/* Telemetry and SSDV packets waiting to be uploaded are appended to a file
+ * before anything is sent, and an "ack" line is appended once the server
+ * has taken them. Records that were never acked are sent again after a
+ * restart; the file is truncated whenever the queue runs empty. Records
+ * are dropped, oldest first, when there are too many or they are too old
+ * to be worth sending. */
+class SpoolThread : public EZ::SimpleThread
+{
+    struct record
+    {
+        unsigned long seq;
+        time_t queued;
+        std::string key;
+        Json::Value value;
+    };
+
+    const std::string filename;
+    FILE *file;
+    /* Lines written since the last fsync, which only the thread does */
+    bool dirty;
+    /* Problem found with lock held, to be reported once it is released */
+    std::string notice;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool term;
+
+    std::deque<record> pending;
+    unsigned long next_seq;
+
+    /* Keys of recently queued records, so that a sentence decoded twice
+     * (e.g., once live and once from the audio history) is sent once */
+    std::set<std::string> recent_keys;
+    std::deque<std::string> recent_order;
+
+    std::string callsign, couch_uri, couch_db;
+    bool configured, changed;
+
+    time_t retry_at;
+    int backoff;
+
+    void replay();
+    void write_line(const Json::Value &line);
+    void sync();
+    void append(const std::string &key, Json::Value &value);
+    void ack(unsigned long seq);
+    size_t expire(time_t now);
+    bool sendable(const record &r) const;
+    void send(habitat::Uploader *uploader, const Json::Value &value);
+    void send_ssdv(const Json::Value &value);
+
+    void log(const std::string &message);
+    void warning(const std::string &message);
+
+public:
+    SpoolThread(const std::string &filename);
+    ~SpoolThread();
+
+    void settings(const std::string &callsign, const std::string &couch_uri,
+                  const std::string &couch_db);
+    void reset();
+
+    void payload_telemetry(const std::string &data,
+                           const Json::Value &metadata, int time_created);
+    void listener_telemetry(const Json::Value &data, int time_created);
+    void ssdv_packet(const std::string &url, const std::string &callsign,
+                     const std::string &packet, int fixes);
+
+    void *run();
+    void shutdown();
+};
+
+} /* namespace spool */
+} /* namespace dl_fldigi */
+
+#endif /* DL_FLDIGI_SPOOL_H */
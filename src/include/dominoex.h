@@ -34,6 +34,7 @@
 #include "fftfilt.h"
 #include "dominovar.h"
 #include "mbuffer.h"
+#include "tonecache.h"
 
 // NASA coefficients for viterbi encode/decode algorithms
 #define	K	7
@@ -70,6 +71,7 @@ protected:
 // common variables
 	double	phase[MAXFFTS + 1];
 	double	txphase;
+	tone_cache	txtones;
 	int		symlen;
 	int		doublespaced;
 	double	tonespacing;
@@ -69,7 +69,7 @@ protected:
 	Cmovavg			*average;
 //tx
 	FELD_STATE	tx_state;
-	double txphacc;
+	oscillator txosc;
 	double txcounter;
 	double hell_bandwidth;
 	double filter_bandwidth;
@@ -94,7 +94,6 @@ protected:
 	int fntnbr;
 	
 	complex mixer(complex);
-	double nco(double);
 	void	rx(complex);
 	void	FSKHELL_rx(complex);
 	void	send_symbol(int currsymbol, int nextsymbol);
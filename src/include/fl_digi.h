@@ -201,6 +201,8 @@ extern void cb_mnuVisitURL(Fl_Widget*, void* arg);
 extern void put_freq(double frequency);
 extern void put_Bandwidth(int bandwidth);
 extern void global_display_metric(double metric);
+extern void ui_redraw(Fl_Widget* w);
+extern void start_ui_updates(void);
 extern void put_cwRcvWPM(double wpm);
 
 extern void set_scope_mode(Digiscope::scope_mode md);
@@ -274,6 +276,7 @@ extern void resetCONTESTIA();
 extern void resetTHOR();
 extern void resetDOMEX();
 extern void resetSoundCard();
+extern void updateTxRoute();
 extern void restoreFocus(Fl_Widget* w = 0);
 extern void setReverse(int);
 extern void clearQSO();
@@ -40,6 +40,7 @@
 #include "complex.h"
 #include "mfskvaricode.h"
 #include "mbuffer.h"
+#include "tonecache.h"
 #include "picture.h"
 
 
@@ -143,6 +144,7 @@ enum {
 protected:
 // general
 	double phaseacc;
+	tone_cache txtones;
 	int symlen;
 	int symbits;
 	int numtones;
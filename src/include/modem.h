@@ -11,6 +11,7 @@
 #include "digiscope.h"
 #include "globals.h"
 #include "morse.h"
+#include "oscillator.h"
 
 #define	OUTBUFSIZE	16384
 // Constants for signal searching & s/n threshold
@@ -18,6 +19,26 @@
 
 #define TWOPI (2.0 * M_PI)
 
+// Configuration read by the modems' rx_process().  The TRX thread takes a
+// copy of these progdefaults fields at every block boundary and hands it to
+// the active modem, so a block is always decoded with one consistent set of
+// values.  version is incremented whenever any of the values changes.
+struct rx_params {
+	unsigned version;
+	bool	slowcpu;
+	double	RTTY_BW;
+	int	oliviatones;
+	int	oliviabw;
+	int	oliviasmargin;
+	int	oliviasinteg;
+	bool	THOR_FILTER;
+	int	mt63_interleave;
+	bool	mt63_rx_integration;
+	bool	mt63_8bit;
+};
+
+extern bool rx_params_take(rx_params& p);
+
 class modem : public morse {
 protected:
 	trx_mode mode;
@@ -36,7 +57,7 @@ protected:
 	double	rx_corr;
 	double	tx_corr;
 	double	tx_frequency;
-	double  PTTphaseacc;
+	oscillator PTTosc;
 	double  PTTchannel[OUTBUFSIZE];
 
 // for CW modem use only
@@ -66,6 +87,16 @@ protected:
 
 	unsigned cap;
 
+	rx_params rxp;
+	unsigned rxp_applied;
+	/// True once for every new version of rxp.
+	bool rx_params_changed() {
+		if (rxp.version == rxp_applied)
+			return false;
+		rxp_applied = rxp.version;
+		return true;
+	}
+
 	double track_freq(double freq);
 
 public:
@@ -87,6 +118,8 @@ public:
 	virtual void	searchDown() {};
 	virtual void	searchUp() {};
 
+	void		set_rx_params(const rx_params& p) { rxp = p; }
+
 	void		HistoryON(bool val) {historyON = val;}
 	bool		HistoryON() const { return historyON;}
 
@@ -158,21 +191,18 @@ private:
 
 	void	wfid_sendchars(std::string s);
 
-	double  PTTnco();
-
 public:
 	void	wfid_text(const std::string& s);
 
 // for CW ID transmission
 private:
 	double	cwid_keyshape[128];
-	double	cwid_phaseacc;
+	oscillator cwid_osc;
 	int		RT;
 	int		cwid_symbollen;
 	int		cwid_lastsym;
 public:
 	void	cwid_makeshape();
-	double	cwid_nco(double freq);
 	void	cwid_send_symbol(int bits);
 	void	cwid_send_ch(int ch);
 	void	cwid_sendtext (const std::string& s);
@@ -53,7 +53,7 @@ public:
 	void    init();
 	void    rx_init();
 	void    tx_init(SoundBase*);
-	void    restart();
+	void    restart(const rx_params* p = 0);
 	int     rx_process(const double *buf, int len);
 	int     tx_process();
 
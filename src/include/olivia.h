@@ -63,7 +63,7 @@ private:
 
 	int			preamblesent;
 	int			postamblesent;
-	double		preamblephase;
+	oscillator	preambleosc;
 
 	double		txbasefreq;
 	double		tone_midfreq;
@@ -72,7 +72,6 @@ private:
 	double		ampshape[SR4];
 	double		tonebuff[TONE_DURATION];
 
-	double		nco(double freq);
 	void		send_tones();
 	
 public:
@@ -81,7 +80,7 @@ public:
 	void init();
 	void rx_init();
 	void tx_init(SoundBase *sc);
-	void restart();
+	void restart(const rx_params* p = 0);
 	int rx_process(const double *buf, int len);
 	int tx_process();
 	int unescape(int c);
@@ -0,0 +1,96 @@
+// ----------------------------------------------------------------------------
+// oscillator.h  --  table driven, phase continuous tone generator
+//
+// This file is part of fldigi.
+//
+// Fldigi is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Fldigi is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with fldigi.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#ifndef OSCILLATOR_H
+#define OSCILLATOR_H
+
+#include <stdint.h>
+#include <cstring>
+#include <cmath>
+
+// The phase is a 32 bit fraction of a cycle, so it wraps around by itself
+// and the frequency resolution is samplerate / 2^32.  Samples are read from
+// a shared sine table with linear interpolation; the error is at most
+// about 1.2e-6 ((2 pi / 2048)^2 / 8).  The phase is advanced before each
+// sample is computed, as the phaseacc += ...; sin(phaseacc) code it
+// replaces did.
+
+#define OSC_TABLE_BITS 11
+#define OSC_TABLE_SIZE (1 << OSC_TABLE_BITS)
+
+class oscillator {
+private:
+	uint32_t phase;
+	uint32_t inc;
+
+	static double table[OSC_TABLE_SIZE + 1];
+	static bool init_table();
+	static bool table_ok;
+
+	static double lookup(uint32_t p) {
+		uint32_t i = p >> (32 - OSC_TABLE_BITS);
+		double frac = (p & ((1U << (32 - OSC_TABLE_BITS)) - 1)) *
+			(1.0 / (1U << (32 - OSC_TABLE_BITS)));
+		return table[i] + frac * (table[i + 1] - table[i]);
+	}
+
+public:
+	oscillator() : phase(0), inc(0) { }
+
+	void reset() { phase = 0; }
+	void set_freq(double freq, double samplerate) {
+		inc = (uint32_t)(int64_t)floor(freq / samplerate * 4294967296.0 + 0.5);
+	}
+
+	// advance one sample and return the new value
+	double next_sin() { phase += inc; return lookup(phase); }
+	double next_cos() { phase += inc; return lookup(phase + 0x40000000U); }
+	// value at the current phase
+	double sin() const { return lookup(phase); }
+	double cos() const { return lookup(phase + 0x40000000U); }
+	void step() { phase += inc; }
+	void skip(int len) { if (len > 0) phase += inc * (uint32_t)len; }
+
+	// fill buf with len samples, optionally multiplied by shape[]
+	void fill_sin(double *buf, int len) {
+		for (int i = 0; i < len; i++)
+			buf[i] = next_sin();
+	}
+	void fill_cos(double *buf, int len) {
+		for (int i = 0; i < len; i++)
+			buf[i] = next_cos();
+	}
+	void fill_sin(double *buf, int len, const double *shape) {
+		for (int i = 0; i < len; i++)
+			buf[i] = next_sin() * shape[i];
+	}
+	void fill_cos(double *buf, int len, const double *shape) {
+		for (int i = 0; i < len; i++)
+			buf[i] = next_cos() * shape[i];
+	}
+	// silence that keeps the phase running
+	void fill_zero(double *buf, int len) {
+		if (len <= 0)
+			return;
+		memset(buf, 0, len * sizeof(*buf));
+		skip(len);
+	}
+};
+
+#endif // OSCILLATOR_H
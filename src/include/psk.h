@@ -57,6 +57,7 @@ private:
 	bool			_qpsk;
 	bool			_pskr;
 	double			phaseacc;
+	oscillator		txosc;
 	complex			prevsymbol;
 	unsigned int		shreg;
 	//FEC: 2nd stream
@@ -148,12 +148,31 @@ field and restart the search to return the primary reference.
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <list>
+#include <tr1/unordered_map>
 
 extern char *Composite( char * );
 
+// size of the callsign lookup cache
+#define QRZ_CACHE_SIZE 4096
+
 class QRZ 
 {
   private:
+    struct cached {
+      std::string  call;
+      int          found;
+      std::string  record;
+      std::string  image;
+      long         next;
+    };
+    typedef std::list<cached> cache_list;
+    typedef std::tr1::unordered_map<std::string, cache_list::iterator> cache_map;
+
     char          criteria;
     index_header  idxhdr;
     char          *data;
@@ -172,7 +191,21 @@ class QRZ
     unsigned int  datarecsize;
     long          numkeys;
     int           keylen;
+    char          *idxmap;     // mmap of the whole index file, or NULL
+    long          idxmapsize;
+    char          *datamap;    // mmap of the whole data file, or NULL
+    long          datasize;
+    long          nextoffset;  // data file offset of the next record
+    std::vector<uint64_t> callkeys; // callsign index in CallComp order
+    cache_list    lru;
+    cache_map     lru_map;
+    char          imagename[128];
     void          OpenQRZFiles( const char * );
+    void          CloseQRZFiles();
+    long          FindKey( const char *, int );
+    const char    *DataBlock( long, long & );
+    int           FindCachedCall( char * );
+    int           ParseRec();
     int           FindCallsign( char * );
     int           FindName( char * );
     int           FindState( char * ); 
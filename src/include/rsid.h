@@ -47,6 +47,7 @@
 #include "globals.h"
 #include "modem.h"
 #include "fft.h"
+#include "filters.h"
 
 #define RSID_SAMPLE_RATE 11025.0
 
@@ -58,6 +59,7 @@
 #define RSID_RESOL       2
 #define RSID_NTIMES      (RSID_NSYMBOLS * RSID_RESOL)
 #define RSID_HASH_LEN    256
+#define RSID_DECIM_FIRLEN 64 // taps of the integer decimation low pass
 #define RSID_PRECISION   2.7 // detected frequency precision in Hz
 
 // each rsid symbol has a duration equal to 1024 samples at 11025 Hz smpl rate
@@ -91,9 +93,13 @@ private:
 	double	aFFTAmpl[RSID_FFT_SIZE];
 	Cfft	*rsfft;
 
-	// Hashing tables
-	unsigned char	aHashTable1[RSID_HASH_LEN];
-	unsigned char	aHashTable2[RSID_HASH_LEN];
+	// Inverted index from a pair of symbols to all codes containing
+	// that pair: candidates for key k are aHashCodes[aHashStart[k]]
+	// to aHashCodes[aHashStart[k + 1] - 1]
+	unsigned short	aHashStart1[RSID_HASH_LEN + 1];
+	unsigned short	aHashStart2[RSID_HASH_LEN + 1];
+	unsigned short	*aHashCodes1;
+	unsigned short	*aHashCodes2;
 
 	bool		bPrevTimeSliceValid;
 	int		iPrevDistance;
@@ -111,14 +117,23 @@ private:
 	float*		inptr;
 	static long	src_callback(void* cb_data, float** data);
 
+// integer decimation, used instead of src when the modem
+// sample rate is an exact multiple of RSID_SAMPLE_RATE
+	C_FIR_filter	*decimator;
+	int		decimate_ratio;
+
 // transmit
 	double	*outbuf;
 	size_t  symlen;
 
 private:
 	void	Encode(int code, unsigned char *rsid);
+	void	BuildIndex(unsigned short *start, unsigned short *codes, int sym);
+	void	setup_decimator(int ratio);
 	int		HammingDistance(int iBucket, unsigned char *p2);
 	void	CalculateBuckets(const double *pSpectrum, int iBegin, int iEnd);
+	void	check_candidates(int iBucket, int key, const unsigned short *start,
+			const unsigned short *codes, int &iDistanceMin, int &iSymbol, int &iBin);
 	bool	search_amp( int &pSymbolOut, int &pBinOut);
 	void	search(void);
 	void	apply (int iSymbol, int iBin);
@@ -134,8 +134,7 @@ private:
 	double avgsig;
 
 	double FSKbuf[OUTBUFSIZE];		// signal array for qrq drive
-	double FSKphaseacc;
-	double FSKnco();
+	oscillator FSKosc;
 
 	int rxmode;
 	int txmode;
@@ -150,7 +149,7 @@ private:
 	int rttyparity(unsigned int);
 	bool rx(bool bit);
 // transmit	
-	double nco(double freq);
+	oscillator txosc;
 	void send_symbol(int symbol);
 	void send_stop();
 	void send_char(int c);
@@ -74,13 +74,25 @@ protected:
 	SRC_STATE	*rx_src_state;
 	double		*wrt_buffer;
 
+	// transmit gain and channel routing, applied in the same pass
+	// that converts the modem output to interleaved float frames
+	enum tx_route_t { TX_ROUTE_MONO, TX_ROUTE_BOTH, TX_ROUTE_LEFT, TX_ROUTE_RIGHT };
+	tx_route_t	tx_route;
+	bool		tx_reverse;
+	unsigned	tx_channels;
+	double		tx_level;
+	float		tx_gain;
+	void		tx_route_update(unsigned channels);
+	void		tx_interleave(float* out, const double* in, size_t count);
+	void		tx_interleave_stereo(float* out, const double* left, const double* right, size_t count);
+
 #if USE_SNDFILE
 	SNDFILE* ofCapture;
 	SNDFILE* ifPlayback;
 	SNDFILE* ofGenerate;
 	sf_count_t  read_file(SNDFILE* file, float* buf, size_t count);
 	sf_count_t  write_file(SNDFILE* file, float* buf, size_t count);
-	sf_count_t  write_file(SNDFILE* file, double* buf, size_t count);
+	sf_count_t  write_file(SNDFILE* file, double* buf, size_t count, double gain = 1.0);
 	bool	 format_supported(int format);
 	void	 tag_file(SNDFILE *sndfile, const char *title);
 #endif
@@ -100,6 +112,8 @@ public:
 	virtual size_t	Read(float *, size_t) = 0;
 	virtual void    flush(unsigned dir = UINT_MAX) = 0;
 	virtual bool	must_close(int dir = 0) = 0;
+	void		set_txlevel(double dB);
+	void		tx_route_update(void) { tx_route_update(tx_channels); }
 #if USE_SNDFILE
 	void		get_file_params(const char* def_fname, const char** fname, int* format);
 	int		Capture(bool val);
@@ -199,6 +213,7 @@ private:
         void		src_data_reset(unsigned dir);
         static long	src_read_cb(void* arg, float** data);
         size_t          resample_write(float* buf, size_t count);
+	size_t		ring_write(const double* left, const double* right, size_t count);
 	device_iterator name_to_device(const std::string& name, unsigned dir);
         void 		init_stream(unsigned dir);
         void 		start_stream(unsigned dir);
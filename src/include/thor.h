@@ -33,6 +33,7 @@
 #include "fftfilt.h"
 #include "dominovar.h"
 #include "mbuffer.h"
+#include "tonecache.h"
 
 // NASA coefficients for viterbi encode/decode algorithms
 #define	THOR_K	7
@@ -71,6 +72,7 @@ protected:
 // common variables
 	double	phase[THORMAXFFTS + 1];
 	double	txphase;
+	tone_cache	txtones;
 	int		symlen;
 	int		doublespaced;
 	double	tonespacing;
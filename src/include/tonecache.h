@@ -0,0 +1,46 @@
+// ----------------------------------------------------------------------------
+// tonecache.h  --  pre-rendered tones for the MFSK family transmitters
+//
+// This file is part of fldigi.
+//
+// Fldigi is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Fldigi is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with fldigi.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#ifndef TONECACHE_H
+#define TONECACHE_H
+
+// One symbol of each tone of a mode, as cos(i w) and sin(i w) tables.  A
+// symbol that starts at any phase p is then
+//	cos(p - i w) = cos(p) cos(i w) + sin(p) sin(i w)
+// which costs two multiply-adds per sample and two trig calls per symbol,
+// and keeps the phase continuous from one symbol to the next.
+
+class tone_cache {
+public:
+	tone_cache();
+	~tone_cache();
+
+	// tone k is at f0 + k * spacing Hz
+	bool matches(int ntones, double f0, double spacing, int symlen, double samplerate) const;
+	void build(int ntones, double f0, double spacing, int symlen, double samplerate);
+	// one symbol of tone into buf; phase is moved on to the next symbol
+	void render(double *buf, int tone, double& phase) const;
+
+private:
+	int ntones, len;
+	double f0, spacing, sr;
+	double *ctab, *stab, *step;
+};
+
+#endif // TONECACHE_H
@@ -0,0 +1,119 @@
+// ----------------------------------------------------------------------------
+// view_cw.h  --  multi-channel CW decoder for the signal browser
+//
+// Copyright (C) 2006-2010
+//		Dave Freese, W1HKJ
+//
+// This file is part of fldigi.
+//
+// Fldigi is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Fldigi is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with fldigi.  If not, see <http://www.gnu.org/licenses/>.
+// ----------------------------------------------------------------------------
+
+#ifndef VIEW_CW_H
+#define VIEW_CW_H
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+#include "morse.h"
+#include "fft.h"
+
+#define	VCW_SampleRate	8000
+// one real FFT of VCW_FFTLEN samples every VCW_HOP samples, all channels share it
+#define	VCW_FFTLEN		128
+#define	VCW_HOP			32
+#define	VCW_BINS		(VCW_FFTLEN / 2)
+#define	VCW_BINWIDTH	((double)VCW_SampleRate / VCW_FFTLEN)
+#define	VCW_FRAME_USEC	(1000000 * VCW_HOP / VCW_SampleRate)
+#define	VCW_FRAMERATE	(VCW_SampleRate / VCW_HOP)
+
+#define	VCW_CHANNELS	30
+#define	VCW_REPLEN		16		// longest dot-dash representation kept
+#define	VCW_TEXTLEN		80		// decoded text kept for each channel
+#define	VCW_HITS		3		// frames above squelch before a channel opens
+
+struct CW_CHANNEL {
+	enum { IDLE, RCVNG }	state;
+
+	int				bin;
+	double			frequency;
+
+	double			mag;			// last bin magnitude
+	double			agc_peak;
+	bool			keydown;
+	bool			after_tone;
+	bool			space_sent;
+	unsigned int	start;			// frame of the last key down
+	unsigned int	end;			// frame of the last key up
+
+	long int		last_element;	// usec
+	long int		threshold;		// 2-dot threshold, usec
+	int				timeout;
+
+	char			rep[VCW_REPLEN];
+	int				nrep;
+
+	std::string		text;
+};
+
+class view_cw : public morse {
+public:
+	struct channel_info {
+		int frequency;
+		int wpm;
+		std::string text;
+	};
+
+private:
+	Cfft			*fft;
+	double			inbuf[VCW_FFTLEN];
+	double			fftbuf[VCW_FFTLEN];
+	double			power[VCW_BINS];
+	double			noise[VCW_BINS];
+	int				hits[VCW_BINS];		// consecutive frames above squelch
+	bool			keyed[VCW_BINS];
+	int				inptr;
+	int				hopcnt;
+	unsigned int	frame;
+
+	CW_CHANNEL		channel[VCW_CHANNELS];
+	int				nchannels;
+	double			squelch;
+
+	pthread_mutex_t	text_mutex;
+
+	void	process_frame();
+	void	find_signals();
+	void	decode(int ch);
+	void	update_tracking(int ch, long int dot, long int dash);
+	void	put_char(int ch, const char *c);
+	void	timeout_check(int ch);
+	void	reset(int ch);
+
+public:
+	view_cw();
+	~view_cw();
+	void	restart();
+	int		rx_process(const double *buf, int len);
+	void	clearch(int ch);
+	void	clear();
+	int		get_freq(int ch);
+	int		get_wpm(int ch);
+	void	get_channels(std::vector<channel_info>& info);
+};
+
+extern view_cw *cwviewer;
+
+#endif
@@ -27,18 +27,32 @@
 
 #define PATHMEM 64
 
+// Path metrics are kept as 16 bit values renormalised against state 0 after
+// every symbol; the subtracted amounts are accumulated in norm[] so that the
+// metrics reported by traceback() are identical to unbounded int metrics.
+// Decisions are stored as one bit per state.
 class viterbi  {
 private:
 	int _traceback;
 	int _chunksize;
 	int nstates;
+	int topbit;
+	int nwords;
 	int *output;
-	int *metrics[PATHMEM];
-	int *history[PATHMEM];
+	short *metbuf;
+	short *metrics[PATHMEM];
+	unsigned int *decisions[PATHMEM];
+	int norm[PATHMEM];
 	int sequence[PATHMEM];
 	int mettab[2][256];
+	short *signs;
 	unsigned int ptr;
+	unsigned int filled;
 	int traceback(int *metric);
+	void acs_scalar(const short *prev, short *curr, unsigned int *dec, const int *met);
+#ifdef __SSE2__
+	void acs_sse2(const short *prev, short *curr, unsigned int *dec, int a, int b);
+#endif
 public:
 	viterbi(int k, int poly1, int poly2);
 	~viterbi();
@@ -46,6 +60,7 @@ public:
 	int settraceback(int trace);
 	int setchunksize(int chunk);
 	int decode(unsigned char *sym, int *metric);
+	int decode_block(const unsigned char *syms, int npairs, int *out, int *metric);
 };
 
 
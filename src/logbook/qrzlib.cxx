@@ -29,7 +29,13 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef __WOE32__
+#  include <sys/mman.h>
+#endif
 #include <string>
+#include <algorithm>
 
 #include <iostream>
 using namespace std;
@@ -208,9 +214,50 @@ bool QRZ::ImageExists() {
 	return (hasImage = false);
 }
 
+// map a whole file read-only, NULL if that is not possible here
+static char *mapfile( const char *fname, long &size )
+{
+#ifndef __WOE32__
+	int fd = open( fname, O_RDONLY );
+	if( fd == -1 )
+		return NULL;
+	struct stat st;
+	void *p = MAP_FAILED;
+	if( fstat( fd, &st ) == 0 && st.st_size > 0 )
+		p = mmap( 0, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+	if( p == MAP_FAILED )
+		return NULL;
+	size = st.st_size;
+	return (char *)p;
+#else
+	return NULL;
+#endif
+}
+
+static void unmapfile( char *p, long size )
+{
+#ifndef __WOE32__
+	if( p )
+		munmap( p, size );
+#endif
+}
+
+// callsign index key folded and rearranged so that plain integer comparison
+// gives the CallComp order: suffix, area, prefix
+static uint64_t callkey( const char *s )
+{
+	static const int order[6] = { 3, 4, 5, 2, 0, 1 };
+	char c[6];
+	strncpy( c, s, 6 );
+	uint64_t k = 0;
+	for( int i = 0; i < 6; i++ )
+		k = (k << 8) | (unsigned char)tolower( c[order[i]] );
+	return k;
+}
+
 void QRZ::OpenQRZFiles( const char *fname )
 {
-	long fsize;
 	char dfname[64];
 	char idxname[64];
 	int num1;
@@ -218,6 +265,8 @@ void QRZ::OpenQRZFiles( const char *fname )
 	num1 = 0;
 	num2 = 0;
 
+	CloseQRZFiles();
+
 	if( fname[0] == 0 ) {
 		QRZvalid = 0;
 		return;
@@ -239,51 +288,55 @@ void QRZ::OpenQRZFiles( const char *fname )
 	strcat( dfname, fname );
 	strcat( dfname, ".dat" );
 
-	idxfile = fopen( idxname, "r" );
-	if( idxfile == NULL ) {
-		QRZvalid = 0;
-		return;
-	}
+	if( (idxmap = mapfile( idxname, idxmapsize )) != NULL ) {
+		if( idxmapsize < 48 ) {
+			CloseQRZFiles();
+			QRZvalid = 0;
+			return;
+		}
+		memcpy( &idxhdr.dataname, idxmap, 48 );
+		idxsize = idxmapsize - 48;
+		index = idxmap + 48;
+	} else {
+		idxfile = fopen( idxname, "r" );
+		if( idxfile == NULL ) {
+			QRZvalid = 0;
+			return;
+		}
 
-	fseek( idxfile, 0, SEEK_END );
-	fsize = ftell( idxfile );
-	rewind( idxfile );
+		fseek( idxfile, 0, SEEK_END );
+		idxsize = ftell( idxfile ) - 48;
+		rewind( idxfile );
 
-	idxsize = fsize - 48;
+		if( idxsize <= 0 || (index = (char *) malloc( idxsize )) == NULL ) {
+			fclose( idxfile );
+			QRZvalid = 0;
+			return;
+		}
+		memset( index, 0, idxsize );
 
-	index = (char *) malloc( idxsize );
+		num1 =  fread( &idxhdr.dataname, 48, 1, idxfile );
+		num2 =  fread( index, idxsize, 1, idxfile );
 
-	if( index == NULL ) {
 		fclose( idxfile );
-		QRZvalid = 0;
-		return;
-	}
-	memset( index, 0, idxsize );
-
-	num1 =  fread( &idxhdr.dataname, 48, 1, idxfile );
-	num2 =  fread( index, idxsize, 1, idxfile );
 
-	if (num1 != 1 || num2 != 1) {
-		fclose( idxfile );
-		free( index );
-		QRZvalid = 0;
-		return;
+		if (num1 != 1 || num2 != 1) {
+			CloseQRZFiles();
+			QRZvalid = 0;
+			return;
+		}
 	}
 
-	fflush( stdout );
-
-	fclose( idxfile );
-
-	datafile = fopen( dfname, "r" );
-	if( datafile == NULL ) {
-		free( index );
+	if( (datamap = mapfile( dfname, datasize )) == NULL &&
+		(datafile = fopen( dfname, "r" )) == NULL ) {
+		CloseQRZFiles();
 		QRZvalid = 0;
 		return;
 	}
 
 	sscanf( idxhdr.bytesperkey, "%d", &datarecsize );
 	if( datarecsize == 0 || datarecsize > 32767 ) {
-		free( index );
+		CloseQRZFiles();
 		QRZvalid = 0;
 		return;
 	}
@@ -292,7 +345,7 @@ void QRZ::OpenQRZFiles( const char *fname )
 
 	data = (char *) malloc( datarecsize + 512 );
 	if( data == NULL ) {
-		free( index );
+		CloseQRZFiles();
 		QRZvalid = 0;
 		return;
 	}
@@ -302,22 +355,61 @@ void QRZ::OpenQRZFiles( const char *fname )
 
 	sscanf( idxhdr.keylen, "%d", &keylen );
 	sscanf( idxhdr.numkeys, "%ld", &numkeys );
+	if( keylen <= 0 || numkeys <= 0 ) {
+		CloseQRZFiles();
+		QRZvalid = 0;
+		return;
+	}
+	if( numkeys > idxsize / keylen )
+		numkeys = idxsize / keylen;
 	top = index + idxsize - keylen;
 
+	if( criteria == 'c' && keylen >= 6 ) {
+		callkeys.resize( numkeys );
+		for( long i = 0; i < numkeys; i++ )
+			callkeys[i] = callkey( index + i * keylen );
+	}
 }
 
+void QRZ::CloseQRZFiles()
+{
+	if( idxmap )
+		unmapfile( idxmap, idxmapsize );
+	else if( index )
+		free( index );
+	if( datamap )
+		unmapfile( datamap, datasize );
+	if( data ) free( data );
+	if( datafile ) fclose( datafile );
+	idxmap = datamap = index = data = NULL;
+	idxmapsize = datasize = idxsize = 0;
+	datafile = NULL;
+	numkeys = 0;
+	dfptr = NULL;
+	nextoffset = 0;
+	found = 0;
+	callkeys.clear();
+	lru.clear();
+	lru_map.clear();
+}
 
 QRZ::QRZ( const char *fname )
+	: data(NULL), index(NULL), idxfile(NULL), datafile(NULL),
+	  idxmap(NULL), datamap(NULL)
 {
 	int len = strlen(fname);
 	criteria = fname[ len - 1 ];
 	OpenQRZFiles( fname );
+	ReadRec();
 }
 
 QRZ::QRZ( const char *fname, char c )
+	: data(NULL), index(NULL), idxfile(NULL), datafile(NULL),
+	  idxmap(NULL), datamap(NULL)
 {
 	criteria = c;
 	OpenQRZFiles( fname );
+	ReadRec();
 }
 
 void QRZ::NewDBpath( const char *fname )
@@ -331,10 +423,7 @@ void QRZ::NewDBpath( const char *fname )
 
 QRZ::~QRZ()
 {
-	if( index != NULL ) free( index );
-	if( data  != NULL ) free( data );
-	if( datafile != NULL ) fclose( datafile );
-	return;
+	CloseQRZFiles();
 }
 
 int QRZ::CallComp( char *s1, char *s2 )
@@ -386,10 +475,22 @@ char *Composite( char *s )
 
 int QRZ::ReadDataBlock( long p )
 {
-	rewind( datafile );
-
 	if ( p < 0 ) p = 0;
 
+	if( datamap ) {
+		if( p > datasize )
+			return 1;
+		databytesread = datasize - p;
+		if( databytesread > (long)datarecsize + 512 )
+			databytesread = datarecsize + 512;
+		memcpy( data, datamap + p, databytesread );
+		memset( data + databytesread, '\n', datarecsize + 512 - databytesread );
+		dataoffset = p;
+		return 0;
+	}
+
+	rewind( datafile );
+
 	if( fseek( datafile, p, SEEK_SET ) != 0 ) {
 		return 1;
 	}
@@ -401,16 +502,48 @@ int QRZ::ReadDataBlock( long p )
 	return 0;
 }
 
+// the data from offset p on: straight from the map when there is one,
+// otherwise one block read into data
+const char *QRZ::DataBlock( long p, long &len )
+{
+	if ( p < 0 ) p = 0;
+	if( datamap ) {
+		len = p < datasize ? datasize - p : 0;
+		return datamap + p;
+	}
+	if( ReadDataBlock( p ) != 0 ) {
+		len = 0;
+		return data;
+	}
+	len = databytesread;
+	return data;
+}
+
+// binary search of the index for the first key that does not sort before
+// the first n characters of s; the index is a sorted snapshot of the data
+long QRZ::FindKey( const char *s, int n )
+{
+	long lo = 0, hi = numkeys;
+	while( lo < hi ) {
+		long mid = (lo + hi) / 2;
+		if( strncasecmp( s, index + mid * keylen, n ) <= 0 )
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
 int QRZ::FindCallsign( char *field )
 {
 	char composite[7], testcall[7];
-	char *endofdata;
-	int  matched = 0, iOffset;
+	const char *block, *endofdata, *rec, *eol = NULL;
+	long iOffset, len;
+	int  matched = 1;
 
-	memset( composite, 0, 6 );
-	memset( testcall, 0, 6 );
 	found = 0;
-	idxptr = index;
+	dfptr = NULL;
+	nextoffset = 0;
 
 	if( strlen( field ) < 3 )  // must be a valid callsign
 		return 0;
@@ -420,60 +553,65 @@ int QRZ::FindCallsign( char *field )
 
 	strcpy( composite, Composite( field ) );
 
-	for( iOffset = 0; iOffset < numkeys; iOffset++, idxptr += keylen )
-		if( CallComp( composite, idxptr) <= 0 )
-			break;
+	if( callkeys.empty() )
+		return 0;
+	iOffset = lower_bound( callkeys.begin(), callkeys.end(), callkey( composite ) ) -
+		callkeys.begin();
+	bool skip = iOffset != 0;
 
 	iOffset--;
 	if (iOffset < 0) iOffset = 0;
 
-	ReadDataBlock( datarecsize * iOffset );
-
-	dfptr = data;
-	endofdata = data + databytesread;
+	block = DataBlock( datarecsize * iOffset, len );
+	endofdata = block + len;
+	rec = block;
 
-	endofline = strchr( dfptr, '\n' );
+// the block starts part way through a record
+	if( skip && (eol = (const char *)memchr( rec, '\n', endofdata - rec )) != NULL )
+		rec = eol + 1;
 
-	if( idxptr != index ) {
-		endofline = strchr( dfptr, '\n' );
-		if (endofline != NULL )
-			dfptr = endofline + 1;
+// records are compared where they lie, only the match is copied out
+	while ( rec < endofdata ) {
+		memset( testcall, 0, sizeof(testcall) );
+		memcpy( testcall, rec, min( 6L, (long)(endofdata - rec) ) );
+		if( (matched = CallComp( composite, Composite(testcall) ) ) <= 0 )
+			break;
+		if( (eol = (const char *)memchr( rec, '\n', endofdata - rec )) == NULL )
+			return 0;
+		rec = eol + 1;
 	}
 
-	found = 0;
+	if ( matched != 0 || rec >= endofdata )
+		return 0;
 
-	while ( !found && (dfptr < endofdata ) ) {
-		memcpy( testcall, dfptr, 6 );
-		if( (matched = CallComp( composite, Composite(testcall) ) ) <= 0 )
-			found = 1;
-		else {
-			endofline = strchr( dfptr, '\n' );
-			dfptr = endofline + 1;
-		}
-	}
+	eol = (const char *)memchr( rec, '\n', endofdata - rec );
+	if( eol == NULL )
+		eol = endofdata;
+	len = min( (long)(eol - rec), (long)sizeof(recbuffer) - 1 );
+	memcpy( recbuffer, rec, len );
+	recbuffer[len] = 0;
+
+// nextrec() reads on from here when it is asked to
+	nextoffset = datarecsize * iOffset + (eol - block) + (eol < endofdata);
 
-	if ( matched == 0 ) {
-		endofline = strchr( dfptr, '\n' );
-		*endofline = 0;
-		strcpy( recbuffer, dfptr );
 // check for old call referencing new call
-		if (strlen(recbuffer) < 15 ) {
-			dfptr = strchr( dfptr, ',' ) + 1;
-			strcpy( recbuffer, dfptr );
-//	  Qcall = recbuffer;
-			found = -1;
-		} else {
-			found = 1;
-			dfptr = endofline + 1;  // point to next record
-		}
-		return (found);
-	}
-	found = 0;
-	return 0;
+	if (len < 15 ) {
+		char *comma = strchr( recbuffer, ',' );
+		if( comma )
+			memmove( recbuffer, comma + 1, strlen( comma + 1 ) + 1 );
+		found = -1;
+	} else
+		found = 1;
+	return (found);
 }
 
 int QRZ::nextrec()
 {
+	if( dfptr == NULL ) {
+		if( ReadDataBlock( nextoffset ) != 0 )
+			return 0;
+		dfptr = data;
+	}
 	if( dfptr > data + datarecsize ) {
 		if( ReadDataBlock( dataoffset + (dfptr - data) ) != 0)
 			return 0;
@@ -524,11 +662,8 @@ int QRZ::FindName( char *field )
 	}
 
 	found = 0;
-	idxptr = index;
-
-	for( iOffset = 0; iOffset < numkeys; iOffset++, idxptr += keylen )
-		if( strncasecmp( sIdxName, idxptr, keylen ) <= 0 )
-			break;
+	iOffset = FindKey( sIdxName, keylen );
+	idxptr = index + iOffset * keylen;
 
 	iOffset--;
 	if (iOffset < 0) iOffset = 0;
@@ -612,11 +747,8 @@ int QRZ::FindState( char *field )
 	if (compsize > keylen) compsize = keylen;
 
 	found = 0;
-	idxptr = index;
-
-	for( iOffset = 0; iOffset < numkeys; iOffset++, idxptr += keylen )
-		if( strncasecmp( field, idxptr, compsize ) <= 0 )
-			break;
+	iOffset = FindKey( field, compsize );
+	idxptr = index + iOffset * keylen;
 
 	iOffset--;
 	if (iOffset < 0) iOffset = 0;
@@ -674,11 +806,8 @@ int QRZ::FindZip( char *field )
 	char *zip;
 
 	found = 0;
-	idxptr = index;
-
-	for( iOffset = 0; iOffset < numkeys; iOffset++, idxptr += keylen )
-		if( strncasecmp( field, idxptr, 5 ) <= 0 )
-		break;
+	iOffset = FindKey( field, 5 );
+	idxptr = index + iOffset * keylen;
 
 	iOffset--;
 	if (iOffset < 0) iOffset = 0;
@@ -732,8 +861,7 @@ int QRZ::FindRecord( char *field )
 
 	switch (criteria) {
 		case 'c' :
-			FindCallsign( field );
-			break;
+			return FindCachedCall( field );
 		case 'n' :
 			FindName( field );
 			break;
@@ -749,7 +877,63 @@ int QRZ::FindRecord( char *field )
 static char empty[] = { '\0' };
 
 
+// bulk lookups (log import, spot annotation) ask for the same calls over
+// and over: the raw records of the last QRZ_CACHE_SIZE calls are kept
+int QRZ::FindCachedCall( char *field )
+{
+	string call( field );
+	for( size_t i = 0; i < call.length(); i++ )
+		call[i] = toupper( call[i] );
+
+	cache_map::iterator it = lru_map.find( call );
+	if( it != lru_map.end() ) {
+		lru.splice( lru.begin(), lru, it->second );
+		const cached &c = *it->second;
+		found = c.found;
+		strcpy( recbuffer, c.record.c_str() );
+		dfptr = NULL;
+		nextoffset = c.next;
+		if( !ParseRec() )
+			return 0;
+		if( c.image.empty() )
+			Qimagefname = NULL;
+		else {
+			strcpy( imagename, c.image.c_str() );
+			Qimagefname = imagename;
+		}
+		return 1;
+	}
+
+	FindCallsign( field );
+
+	cached c;
+	c.call = call;
+	c.found = found;
+	c.record = recbuffer;
+	c.next = nextoffset;
+	int ret = ReadRec();
+	if( ret && Qimagefname )
+		c.image = Qimagefname;
+
+	lru.push_front( c );
+	lru_map[call] = lru.begin();
+	if( lru_map.size() > QRZ_CACHE_SIZE ) {
+		lru_map.erase( lru.back().call );
+		lru.pop_back();
+	}
+	return ret;
+}
+
 int QRZ::ReadRec()
+{
+	if( ParseRec() ) {
+		Qimagefname = QRZImageFilename (GetCall());
+		return( 1 );
+	}
+	return( 0 );
+}
+
+int QRZ::ParseRec()
 {
 	char *comma;
 
@@ -797,7 +981,6 @@ int QRZ::ReadRec()
 		Qp_class = comma + 1;
 		//Qp_class[1] = 0;
 		*(comma + 2) = 0;
-		Qimagefname = QRZImageFilename (GetCall());
 		return( 1 );
 	} else {
 		Qcall = empty;
@@ -505,6 +505,7 @@ int main(int argc, char ** argv)
 #endif
 
 	Fl::add_timeout(.05, delayed_startup);
+	start_ui_updates();
 
 	dl_fldigi::ready(bHAB);
 
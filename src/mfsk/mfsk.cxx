@@ -770,24 +770,16 @@ int mfsk::rx_process(const double *buf, int len)
 
 void mfsk::sendsymbol(int sym)
 {
-	double f, phaseincr;
+	double f0 = get_txfreq_woffset() - bandwidth / 2;
 
-	f = get_txfreq_woffset() - bandwidth / 2;
-	
 	sym = grayencode(sym & (numtones - 1));
 	if (reverse)
 		sym = (numtones - 1) - sym;
 
-	phaseincr = TWOPI * (f + sym*tonespacing) / samplerate;
-	
-	for (int i = 0; i < symlen; i++) {
-		outbuf[i] = cos(phaseacc);
-		phaseacc -= phaseincr;
-		if (phaseacc > M_PI)
-			phaseacc -= TWOPI;
-		else if (phaseacc < M_PI)
-			phaseacc += TWOPI;
-	}
+	// rebuilt when the transmit frequency moves
+	if (!txtones.matches(numtones, f0, tonespacing, symlen, samplerate))
+		txtones.build(numtones, f0, tonespacing, symlen, samplerate);
+	txtones.render(outbuf, sym, phaseacc);
 	ModulateXmtr(outbuf, symlen);
 
 }
@@ -46,6 +46,12 @@
 #endif
 
 #include <signal.h>
+#ifndef __WOE32__
+#  include <unistd.h>
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#endif
 
 #include "main.h"
 #include "configuration.h"
@@ -54,6 +60,7 @@
 #include "arq_io.h"
 
 #include "threads.h"
+#include "timeops.h"
 #include "socket.h"
 #include "debug.h"
 #include "qrunner.h"
@@ -469,6 +476,14 @@ ARQ_SOCKET_Server* ARQ_SOCKET_Server::inst = 0;
 Socket arqclient;
 bool isSocketConnected = false;
 
+// Set by arq_wait when poll() has seen data (or a hangup) on arqclient
+static bool arq_client_readable = false;
+
+// True while the arq thread runs; nothing else drains arq_out
+static bool arq_enabled = false;
+
+static void arq_wakeup(void);
+
 ARQ_SOCKET_Server::ARQ_SOCKET_Server()
 {
 	server_socket = new Socket;
@@ -570,6 +585,8 @@ void arq_run(Socket s)
 	arqclient.set_nonblocking();
 	isSocketConnected = true;
 	arqmode = true;
+	// have the loop add the new client to its poll set
+	arq_wakeup();
 }
 
 void arq_stop()
@@ -583,7 +600,11 @@ void WriteARQsocket(unsigned char* data, size_t len)
 {
 	if (!isSocketConnected) return;
 	try {
-		arqclient.send(data, len);
+		size_t n;
+		while (len && (n = arqclient.send(data, len)) > 0) {
+			data += n;
+			len -= n;
+		}
 	}
 	catch (const SocketException& e) {
 		LOG_ERROR("%s", e.what());
@@ -595,12 +616,36 @@ bool Socket_arqRx()
 {
 	if (!isSocketConnected) return false;
 
-	string instr;
-
 	try {
+#ifndef __WOE32__
+		// Only read when poll() says so: the socket timeout would
+		// otherwise make every empty read wait for it.  Socket::recv
+		// returns 0 for both EOF and no data, so call recv(2) here.
+		if (arq_client_readable) {
+			char buf[BUFSIZ];
+			arq_client_readable = false;
+			ssize_t n = ::recv(arqclient.fd(), buf, sizeof(buf), 0);
+			if (n == 0) {
+				// end of file: the client has gone
+				arq_stop();
+				return false;
+			}
+			if (n == -1) {
+				if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+					LOG_PERROR("recv");
+					arq_stop();
+					return false;
+				}
+			}
+			else
+				txstring.append(buf, n);
+		}
+#else
+		string instr;
 		size_t n = arqclient.recv(instr);
 		if ( n > 0)
 			txstring.append(instr);
+#endif
 
 		if (!bSend0x06 && arqtext.empty() && !txstring.empty()) {
 			arqtext = txstring;
@@ -631,23 +676,96 @@ bool Socket_arqRx()
 // Send ARQ characters to ARQ client
 //-----------------------------------------------------------------------------
 #if !defined(__WOE32__) && !defined(__APPLE__)
-void WriteARQSysV(unsigned char data)
+// The client reads one character per message
+void WriteARQSysV(const unsigned char* data, size_t len)
 {
 	rxmsgid = msgget( (key_t) progdefaults.rx_msgid, 0666);
 	if ( rxmsgid != -1) {
 		rxmsgst.msg_type = 1;
-		rxmsgst.c = data;
-		msgsnd (rxmsgid, (void *)&rxmsgst, 1, IPC_NOWAIT);
+		for (size_t i = 0; i < len; i++) {
+			rxmsgst.c = data[i];
+			msgsnd (rxmsgid, (void *)&rxmsgst, 1, IPC_NOWAIT);
+		}
 	}
 }
 #endif
 
-void WriteARQ(unsigned char data)
+// Characters for the ARQ client are queued here and sent by the arq thread,
+// with one send() for the whole batch, ARQ_FLUSH_MS after the first of them
+// was queued.  On woe32 the arq thread cannot be woken, so they are sent
+// straight away as before.  Nothing is queued while the arq thread is not
+// running, and the oldest are dropped when more than ARQ_OUT_MAX wait.
+
+#define ARQ_FLUSH_MS 10
+#define ARQ_OUT_MAX 65536
+
+static pthread_mutex_t arq_out_mutex = PTHREAD_MUTEX_INITIALIZER;
+static string arq_out;
+static struct timespec arq_out_first;
+
+static void arq_write(const unsigned char* data, size_t len)
+{
+#ifndef __WOE32__
+	if (!arq_enabled)
+		return;
+
+	pthread_mutex_lock(&arq_out_mutex);
+	bool first = arq_out.empty();
+	if (first)
+		clock_gettime(CLOCK_MONOTONIC, &arq_out_first);
+	arq_out.append((const char*)data, len);
+	if (arq_out.length() > ARQ_OUT_MAX) {
+		// keep the newest half, so that this does not happen per character
+		size_t drop = arq_out.length() - ARQ_OUT_MAX / 2;
+		LOG_WARN("ARQ output not drained, %zu characters dropped", drop);
+		arq_out.erase(0, drop);
+	}
+	pthread_mutex_unlock(&arq_out_mutex);
+
+	if (first)
+		arq_wakeup();
+#else
+	WriteARQsocket((unsigned char*)data, len);
+#endif
+}
+
+// Called by the arq thread.  Returns the number of ms until the queue is
+// due, or -1 if it is empty.
+static int arq_flush(bool force)
 {
-	WriteARQsocket(&data, 1);
+	static string out;
+
+	pthread_mutex_lock(&arq_out_mutex);
+	if (arq_out.empty()) {
+		pthread_mutex_unlock(&arq_out_mutex);
+		return -1;
+	}
+	if (!force) {
+		struct timespec age;
+		clock_gettime(CLOCK_MONOTONIC, &age);
+		age -= arq_out_first;
+		int ms = age.tv_sec * 1000 + age.tv_nsec / 1000000;
+		if (ms < ARQ_FLUSH_MS) {
+			pthread_mutex_unlock(&arq_out_mutex);
+			return ARQ_FLUSH_MS - ms;
+		}
+	}
+	// both strings keep their capacity
+	out.swap(arq_out);
+	pthread_mutex_unlock(&arq_out_mutex);
+
+	WriteARQsocket((unsigned char*)out.data(), out.length());
 #if !defined(__WOE32__) && !defined(__APPLE__)
-	WriteARQSysV(data);
+	WriteARQSysV((const unsigned char*)out.data(), out.length());
 #endif
+	out.clear();
+
+	return -1;
+}
+
+void WriteARQ(unsigned char data)
+{
+	arq_write(&data, 1);
 }
 
 //-----------------------------------------------------------------------------
@@ -671,7 +789,64 @@ static pthread_mutex_t arq_mutex = PTHREAD_MUTEX_INITIALIZER;
 static void *arq_loop(void *args);
 
 static bool arq_exit = false;
-static bool arq_enabled;
+
+// The loop sleeps in poll() on the client socket and on a pipe that the
+// other threads write to when they need the loop (end of ARQ text, abort,
+// new client, characters queued for the client, exit).  The SysV queue and the autofiles cannot be waited
+// on, so they are still polled: every 50 ms while a SysV queue exists,
+// otherwise every 250 ms, and every 10 ms while 0x06 waits for the end
+// of the transmission.
+#ifndef __WOE32__
+static int arq_wake[2] = { -1, -1 };
+#endif
+
+static void arq_wakeup(void)
+{
+#ifndef __WOE32__
+	char c = 0;
+	if (arq_wake[1] != -1 && write(arq_wake[1], &c, 1) == -1 && errno != EAGAIN)
+		LOG_PERROR("write");
+#endif
+}
+
+static void arq_wait(int due)
+{
+#ifndef __WOE32__
+	struct pollfd fds[2];
+	int nfds = 1, timeout = 250;
+
+	fds[0].fd = arq_wake[0];
+	fds[0].events = POLLIN;
+	if (isSocketConnected) {
+		fds[1].fd = arqclient.fd();
+		fds[1].events = POLLIN;
+		nfds++;
+	}
+
+	if (bSend0x06)
+		timeout = 10;
+#  if !defined(__APPLE__)
+	else if (txmsgid != -1)
+		timeout = 50;
+#  endif
+	if (due >= 0 && due < timeout)
+		timeout = due;
+
+	if (poll(fds, nfds, timeout) <= 0)
+		return;
+
+	if (fds[0].revents) {
+		char buf[64];
+		while (read(arq_wake[0], buf, sizeof(buf)) > 0)
+			;
+	}
+	// POLLHUP and POLLERR are followed by a read that returns 0 or fails
+	if (nfds > 1 && (fds[1].revents & (POLLIN | POLLHUP | POLLERR)))
+		arq_client_readable = true;
+#else
+	MilliSleep(50);
+#endif
+}
 
 static void *arq_loop(void *args)
 {
@@ -698,9 +873,9 @@ static void *arq_loop(void *args)
 			WRAP_auto_arqRx();
 #endif
 		pthread_mutex_unlock (&arq_mutex);
-		MilliSleep(50);
-
+		arq_wait(arq_flush(false));
 	}
+	arq_flush(true);
 // exit the arq thread
 	return NULL;
 }
@@ -712,6 +887,19 @@ void arq_init()
 	txstring.clear();
 	cmdstring.clear();
 
+#ifndef __WOE32__
+	if (arq_wake[0] == -1) {
+		if (pipe(arq_wake) == -1) {
+			LOG_PERROR("pipe");
+			return;
+		}
+		for (int i = 0; i < 2; i++) {
+			fcntl(arq_wake[i], F_SETFL, O_NONBLOCK);
+			fcntl(arq_wake[i], F_SETFD, FD_CLOEXEC);
+		}
+	}
+#endif
+
 	if (!ARQ_SOCKET_Server::start( progdefaults.arq_address.c_str(), progdefaults.arq_port.c_str() ))
 		return;
 
@@ -731,6 +919,7 @@ void arq_close(void)
 
 // tell the arq thread to kill it self
 	arq_exit = true;
+	arq_wakeup();
 
 // and then wait for it to die
 	pthread_join(arq_thread, NULL);
@@ -752,6 +941,7 @@ char arq_get_char()
 			bSend0x06 = true;
 			arq_text_available = false;
 			c = 0x03;
+			arq_wakeup();
 		}
 	}
 	pthread_mutex_unlock (&arq_mutex);
@@ -769,6 +959,7 @@ void AbortARQ() {
 	arq_text_available = false;
 	bSend0x06 = true;
 	pthread_mutex_unlock (&arq_mutex);
+	arq_wakeup();
 }
 
 // Special notification for PSKMAIL: new mode marked only, in following
@@ -778,11 +969,7 @@ void pskmail_notify_rsid(trx_mode mode)
 	char buf[64];
 	int n = snprintf(buf, sizeof(buf), "%c<Mode:%s>\n", 0x12, mode_info[mode].name);
 	if (n > 0 && n < (int)sizeof(buf)) {
-		WriteARQsocket((unsigned char*)buf, n);
-#if !defined(__WOE32__) && !defined(__APPLE__)
-		for (int ii=0; ii < n; ii++)
-			WriteARQSysV((unsigned char)buf[ii]);
-#endif
+		arq_write((unsigned char*)buf, n);
 		ReceiveText->addstr(buf, FTextBase::CTRL);
 	}
 }
@@ -796,11 +983,7 @@ void pskmail_notify_s2n(double s2n_ncount, double s2n_avg, double s2n_stddev)
 	int n = snprintf(buf, sizeof(buf), "%c<s2n: %1.0f, %1.1f, %1.1f>",
 			 0x12, s2n_ncount, s2n_avg, s2n_stddev);
 	if (n > 0 && n < (int)sizeof(buf)) {
-		WriteARQsocket((unsigned char*)buf, n);
-#if !defined(__WOE32__) && !defined(__APPLE__)
-		for (int ii=0; ii < n; ii++)
-			WriteARQSysV((unsigned char)buf[ii]);
-#endif
+		arq_write((unsigned char*)buf, n);
 		ReceiveText->addstr(buf, FTextBase::CTRL);
 	}
 }
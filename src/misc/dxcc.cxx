@@ -25,6 +25,7 @@
 #include <cstring>
 #include <cctype>
 #include <cstdlib>
+#include <cstdio>
 #include <fstream>
 #include <sstream>
 #include <string>
@@ -33,6 +34,14 @@
 #include <tr1/unordered_map>
 #include <algorithm>
 
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifndef __WOE32__
+#  include <sys/mman.h>
+#endif
+
 #include <FL/filename.H>
 #include "fileselect.h"
 
@@ -57,58 +66,206 @@ dxcc::dxcc(const char* cn, int cq, int itu, const char* ct, float lat, float lon
 	continent[2] = '\0';
 }
 
-typedef unordered_map<string, dxcc*> dxcc_map_t;
-typedef vector<dxcc*> dxcc_list_t;
-static dxcc_map_t* cmap = 0;
-static dxcc_list_t* clist = 0;
-static vector<string>* cnames = 0;
+// cty.dat is compiled into a flat prefix trie.  Every node's children are
+// contiguous and sorted, a node may end both a prefix and an "=" exact call,
+// and the whole thing is a single block of memory that is written to
+// HomeDir/cty.cache and mapped straight back in when cty.dat is unchanged:
+//
+//	cty_header | cty_record[nentries] | cty_node[nnodes] | country names
+//
+// The first nentities records are the cty.dat entities, the rest are copies
+// made for the (cq), [itu], <lat/lon> and {continent} overrides.
+
+#define CTY_MAGIC	"FLCTY\0\0\0"
+#define CTY_VERSION	1
+#define CTY_BOM		0x01020304
+
+struct cty_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t bom;		// the cache is in host byte order
+	uint64_t hash;		// of cty.dat
+	uint64_t size;
+	uint32_t nentities;
+	uint32_t nentries;
+	uint32_t nnodes;
+	uint32_t names_len;
+};
+
+struct cty_record {
+	uint32_t name;		// offset in the names table
+	int32_t cq_zone;
+	int32_t itu_zone;
+	float latitude;
+	float longitude;
+	float gmt_offset;
+	char continent[4];
+};
+
+struct cty_node {
+	uint32_t child;		// index of the first child
+	int32_t prefix;		// record for a prefix ending here, or -1
+	int32_t exact;		// record for an "=" call ending here, or -1
+	uint8_t nchild;
+	char label;
+	uint16_t pad;
+};
+
+static const cty_node* nodes = 0;
+static vector<dxcc>* entries = 0;
+static vector<dxcc*>* clist = 0;
+
+// the block that nodes and the country names point into
+static char* image = 0;
+static size_t image_len = 0;
+static bool image_mapped = false;
+
+static uint64_t fnv1a(const char* p, size_t len)
+{
+	uint64_t h = 14695981039346656037ULL;
+	while (len--) {
+		h ^= (unsigned char)*p++;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
 
-static void add_prefix(string& prefix, dxcc* entry);
+static bool read_file(const char* filename, string& buf)
+{
+	ifstream in(filename, ios::binary);
+	if (!in)
+		return false;
+	ostringstream ss;
+	ss << in.rdbuf();
+	buf = ss.str();
+	return true;
+}
 
-bool dxcc_open(const char* filename)
+// ----------------------------------------------------------------------------
+// cty.dat parser and trie compiler, only used when the cache is stale
+
+struct cty_entry {
+	int name;
+	int cq_zone;
+	int itu_zone;
+	char continent[3];
+	float latitude;
+	float longitude;
+	float gmt_offset;
+	bool base;
+};
+
+struct cty_tnode {
+	map<char, int> child;
+	int prefix;
+	int exact;
+	cty_tnode() : prefix(-1), exact(-1) { }
+};
+
+struct cty_build {
+	vector<string> names;
+	vector<cty_entry> entries;
+	vector<cty_tnode> trie;
+	cty_build() : trie(1) { }
+	void add(const string& key, int entry);
+};
+
+void cty_build::add(const string& key, int entry)
 {
-	if (cmap)
-		return true;
+	bool exact = !key.empty() && key[0] == '=';
+	int n = 0;
+	for (string::size_type i = exact; i < key.length(); i++) {
+		map<char, int>::iterator c = trie[n].child.find(key[i]);
+		if (c == trie[n].child.end()) {
+			trie.push_back(cty_tnode());
+			c = trie[n].child.insert(make_pair(key[i], (int)trie.size() - 1)).first;
+		}
+		n = c->second;
+	}
+	if (n == 0) // empty prefix
+		return;
+	(exact ? trie[n].exact : trie[n].prefix) = entry;
+}
 
-	ifstream in(filename);
-	if (!in) {
-		LOG_VERBOSE("Could not read contest country file \"%s\"", filename);
-		return false;
+static void add_prefix(cty_build& b, string& prefix, int entry)
+{
+	string::size_type i = prefix.find_first_of("([<{");
+	if (likely(i == string::npos)) {
+		b.add(prefix, entry);
+		return;
 	}
 
-	cmap = new dxcc_map_t;
-	cnames = new vector<string>;
-	cnames->reserve(345); // approximate number of dxcc entities
-	clist = new dxcc_list_t;
-	clist->reserve(345);
+	cty_entry e = b.entries[entry];
+	e.base = false;
+	string::size_type j = i, first = i;
+	do {
+		switch (prefix[i++]) { // increment i past opening bracket
+		case '(':
+			if ((j = prefix.find(')', i)) == string::npos)
+				return;
+			prefix[j] = '\0';
+			e.cq_zone = atoi(prefix.data() + i);
+			break;
+		case '[':
+			if ((j = prefix.find(']', i)) == string::npos)
+				return;
+			prefix[j] = '\0';
+			e.itu_zone = atoi(prefix.data() + i);
+			break;
+		case '<':
+			if ((j = prefix.find('/', i)) == string::npos)
+				return;
+			prefix[j] = '\0';
+			e.latitude = atof(prefix.data() + i);
+			if ((j = prefix.find('>', j)) == string::npos)
+				return;
+			prefix[j] = '\0';
+			e.longitude = atof(prefix.data() + i);
+			break;
+		case '{':
+			if ((j = prefix.find('}', i)) == string::npos)
+				return;
+			memcpy(e.continent, prefix.data() + i, 2);
+			break;
+		}
+	} while ((i = prefix.find_first_of("([<{", j)) != string::npos);
+
+	prefix.erase(first);
+	b.entries.push_back(e);
+	b.add(prefix, b.entries.size() - 1);
+}
 
-	dxcc* entry;
+static void cty_parse(const string& text, cty_build& b)
+{
+	istringstream in(text);
 	string record;
 
-	unsigned nrec = 0;
 	while (getline(in, record, ';')) {
 		istringstream is(record);
-		entry = new dxcc;
-		nrec++;
+		cty_entry e;
+		memset(&e, 0, sizeof(e));
+		e.base = true;
 
 		// read country name
-		cnames->resize(cnames->size() + 1);
-		clist->push_back(entry);
-		getline(is, cnames->back(), ':');
-		entry->country = cnames->back().c_str();
+		e.name = b.names.size();
+		b.names.resize(b.names.size() + 1);
+		getline(is, b.names.back(), ':');
 		// cq zone
-		(is >> entry->cq_zone).ignore();
+		(is >> e.cq_zone).ignore();
 		// itu zone
-		(is >> entry->itu_zone).ignore();
+		(is >> e.itu_zone).ignore();
 		// continent
-		(is >> ws).get(entry->continent, 3).ignore();
+		(is >> ws).get(e.continent, 3).ignore();
 
 		// latitude
-		(is >> entry->latitude).ignore();
+		(is >> e.latitude).ignore();
 		// longitude
-		(is >> entry->longitude).ignore();
+		(is >> e.longitude).ignore();
 		// gmt offset
-		(is >> entry->gmt_offset).ignore(256, '\n');
+		(is >> e.gmt_offset).ignore(256, '\n');
+
+		b.entries.push_back(e);
+		int entry = b.entries.size() - 1;
 
 		// prefixes and exceptions
 		int c;
@@ -117,7 +274,7 @@ bool dxcc_open(const char* filename)
 			is >> ws;
 
 			while (getline(is, prefix, ',')) {
-				add_prefix(prefix, entry);
+				add_prefix(b, prefix, entry);
 				if ((c = is.peek()) == '\r' || c == '\n')
 					break;
 			}
@@ -125,30 +282,255 @@ bool dxcc_open(const char* filename)
 
 		in >> ws; // cr/lf after ';'
 	}
+}
+
+// lay out the cache image: entities first, then the override copies, and the
+// trie in breadth first order so that siblings are adjacent
+static void cty_compile(const cty_build& b, uint64_t hash, uint64_t size, string& out)
+{
+	vector<int> order(b.entries.size());
+	uint32_t nentities = 0;
+	for (size_t i = 0; i < b.entries.size(); i++)
+		if (b.entries[i].base)
+			order[i] = nentities++;
+	for (size_t i = 0, n = nentities; i < b.entries.size(); i++)
+		if (!b.entries[i].base)
+			order[i] = n++;
+
+	vector<uint32_t> name_off(b.names.size());
+	string names;
+	for (size_t i = 0; i < b.names.size(); i++) {
+		name_off[i] = names.length();
+		names.append(b.names[i]).append(1, '\0');
+	}
+
+	vector<cty_record> rec(b.entries.size());
+	for (size_t i = 0; i < b.entries.size(); i++) {
+		const cty_entry& e = b.entries[i];
+		cty_record& r = rec[order[i]];
+		memset(&r, 0, sizeof(r));
+		r.name = name_off[e.name];
+		r.cq_zone = e.cq_zone;
+		r.itu_zone = e.itu_zone;
+		r.latitude = e.latitude;
+		r.longitude = e.longitude;
+		r.gmt_offset = e.gmt_offset;
+		memcpy(r.continent, e.continent, 2);
+	}
+
+	vector<cty_node> flat;
+	vector<int> queue;
+	flat.reserve(b.trie.size());
+	queue.reserve(b.trie.size());
+	queue.push_back(0);
+	flat.resize(1);
+	flat[0].label = '\0';
+	for (size_t q = 0; q < queue.size(); q++) {
+		const cty_tnode& t = b.trie[queue[q]];
+		cty_node& n = flat[q];
+		n.child = flat.size();
+		n.nchild = t.child.size();
+		n.prefix = t.prefix < 0 ? -1 : order[t.prefix];
+		n.exact = t.exact < 0 ? -1 : order[t.exact];
+		n.pad = 0;
+		for (map<char, int>::const_iterator c = t.child.begin(); c != t.child.end(); ++c) {
+			queue.push_back(c->second);
+			flat.resize(flat.size() + 1);
+			flat.back().label = c->first;
+		}
+	}
+
+	cty_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, CTY_MAGIC, sizeof(h.magic));
+	h.version = CTY_VERSION;
+	h.bom = CTY_BOM;
+	h.hash = hash;
+	h.size = size;
+	h.nentities = nentities;
+	h.nentries = rec.size();
+	h.nnodes = flat.size();
+	h.names_len = names.length();
+
+	out.reserve(sizeof(h) + rec.size() * sizeof(cty_record) +
+		    flat.size() * sizeof(cty_node) + names.length());
+	out.assign(reinterpret_cast<const char*>(&h), sizeof(h));
+	out.append(reinterpret_cast<const char*>(&rec[0]), rec.size() * sizeof(cty_record));
+	out.append(reinterpret_cast<const char*>(&flat[0]), flat.size() * sizeof(cty_node));
+	out.append(names);
+}
+
+// ----------------------------------------------------------------------------
+// cache file
+
+static string cty_cache_name(void)
+{
+	return HomeDir + "cty.cache";
+}
+
+static bool cty_cache_write(const string& img)
+{
+	string fname = cty_cache_name(), temp = fname + ".tmp";
+	ofstream out(temp.c_str(), ios::binary | ios::trunc);
+	out.write(img.data(), img.length());
+	bool success = out.good();
+	out.close();
+#ifdef __WOE32__
+	if (success)
+		remove(fname.c_str());
+#endif
+	if (success && rename(temp.c_str(), fname.c_str()) == 0)
+		return true;
+	remove(temp.c_str());
+	return false;
+}
+
+static void cty_unmap(void)
+{
+	if (!image)
+		return;
+#ifndef __WOE32__
+	if (image_mapped)
+		munmap(image, image_len);
+	else
+#endif
+		delete [] image;
+	image = 0;
+	image_len = 0;
+	image_mapped = false;
+}
+
+// map in the cache if it was built from this version of cty.dat
+static bool cty_cache_map(uint64_t hash, uint64_t size)
+{
+	string fname = cty_cache_name();
+	int fd = open(fname.c_str(), O_RDONLY);
+	if (fd == -1)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(cty_header)) {
+		close(fd);
+		return false;
+	}
+	cty_header h;
+	if (read(fd, &h, sizeof(h)) != sizeof(h) ||
+	    memcmp(h.magic, CTY_MAGIC, sizeof(h.magic)) || h.version != CTY_VERSION ||
+	    h.bom != CTY_BOM || h.hash != hash || h.size != size ||
+	    h.nnodes == 0 || h.nentities > h.nentries ||
+	    (uint64_t)st.st_size != sizeof(h) + (uint64_t)h.nentries * sizeof(cty_record) +
+				   (uint64_t)h.nnodes * sizeof(cty_node) + h.names_len) {
+		close(fd);
+		return false;
+	}
+
+	image_len = st.st_size;
+#ifndef __WOE32__
+	void* p = mmap(0, image_len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (p != MAP_FAILED) {
+		image = static_cast<char*>(p);
+		image_mapped = true;
+	}
+#endif
+	if (!image) {
+		image = new char[image_len];
+		if (lseek(fd, 0, SEEK_SET) != 0 || read(fd, image, image_len) != (ssize_t)image_len) {
+			close(fd);
+			cty_unmap();
+			return false;
+		}
+	}
+	close(fd);
+	return true;
+}
+
+// point nodes, entries and clist into the image
+static bool cty_attach(void)
+{
+	const cty_header* h = reinterpret_cast<const cty_header*>(image);
+	const cty_record* rec = reinterpret_cast<const cty_record*>(image + sizeof(*h));
+	const cty_node* n = reinterpret_cast<const cty_node*>(rec + h->nentries);
+	const char* names = reinterpret_cast<const char*>(n + h->nnodes);
+
+	// a corrupt cache must not send the lookup outside the image
+	for (uint32_t i = 0; i < h->nnodes; i++)
+		if ((uint64_t)n[i].child + n[i].nchild > h->nnodes ||
+		    n[i].prefix >= (int32_t)h->nentries || n[i].exact >= (int32_t)h->nentries)
+			return false;
+	for (uint32_t i = 0; i < h->nentries; i++)
+		if (rec[i].name >= h->names_len)
+			return false;
+	if (h->names_len && names[h->names_len - 1])
+		return false;
+
+	entries = new vector<dxcc>;
+	entries->reserve(h->nentries);
+	for (uint32_t i = 0; i < h->nentries; i++)
+		entries->push_back(dxcc(names + rec[i].name, rec[i].cq_zone, rec[i].itu_zone,
+					rec[i].continent, rec[i].latitude, rec[i].longitude,
+					rec[i].gmt_offset));
+	clist = new vector<dxcc*>;
+	clist->reserve(h->nentities);
+	for (uint32_t i = 0; i < h->nentities; i++)
+		clist->push_back(&(*entries)[i]);
+	nodes = n;
+
+	return true;
+}
+
+bool dxcc_open(const char* filename)
+{
+	if (nodes)
+		return true;
+
+	string text;
+	if (!read_file(filename, text)) {
+		LOG_VERBOSE("Could not read contest country file \"%s\"", filename);
+		return false;
+	}
+	uint64_t hash = fnv1a(text.data(), text.length());
+
+	if (cty_cache_map(hash, text.length())) {
+		if (cty_attach()) {
+			const cty_header* h = reinterpret_cast<const cty_header*>(image);
+			LOG_VERBOSE("Loaded %u nodes for %u countries from cache", h->nnodes, h->nentities);
+			return true;
+		}
+		dxcc_close();
+	}
+
+	cty_build b;
+	cty_parse(text, b);
+	string img;
+	cty_compile(b, hash, text.length(), img);
+	if (!cty_cache_write(img))
+		LOG_WARN("Could not write %s", cty_cache_name().c_str());
+
+	image_len = img.length();
+	image = new char[image_len];
+	memcpy(image, img.data(), image_len);
+	if (!cty_attach()) {
+		dxcc_close();
+		return false;
+	}
 
-	LOG_VERBOSE("Loaded %" PRIuSZ " prefixes for %u countries", cmap->size(), nrec);
+	const cty_header* h = reinterpret_cast<const cty_header*>(image);
+	LOG_VERBOSE("Loaded %u nodes for %u countries", h->nnodes, h->nentities);
 	return true;
 }
 
 bool dxcc_is_open(void)
 {
-	return cmap;
+	return nodes;
 }
 
 void dxcc_close(void)
 {
-	if (!cmap)
-		return;
-	delete cnames;
-	cnames = 0;
-	map<dxcc*, bool> rm;
-	for (dxcc_map_t::iterator i = cmap->begin(); i != cmap->end(); ++i)
-		if (rm.insert(make_pair(i->second, true)).second)
-			delete i->second;
-	delete cmap;
-	cmap = 0;
+	nodes = 0;
 	delete clist;
 	clist = 0;
+	delete entries;
+	entries = 0;
+	cty_unmap();
 }
 
 const vector<dxcc*>* dxcc_entity_list(void)
@@ -156,96 +538,50 @@ const vector<dxcc*>* dxcc_entity_list(void)
 	return clist;
 }
 
+static inline const cty_node* find_child(const cty_node* n, char c)
+{
+	const cty_node* p = nodes + n->child;
+	for (const cty_node* e = p + n->nchild; p < e; p++) {
+		if (p->label == c)
+			return p;
+		if (p->label > c)
+			break;
+	}
+	return NULL;
+}
+
 const dxcc* dxcc_lookup(const char* callsign)
 {
-	if (!cmap || !callsign || !*callsign)
+	if (!nodes || !callsign || !*callsign)
 		return NULL;
 
-	string sstr;
-	sstr.resize(strlen(callsign) + 1);
-	transform(callsign, callsign + sstr.length() - 1, sstr.begin() + 1, static_cast<int (*)(int)>(toupper));
+	// walk the trie once, remembering the longest prefix seen on the way
+	const cty_node* n = nodes;
+	const char* p = callsign;
+	int32_t prefix = -1;
+	bool kg4 = false;
+	for (; *p; p++) {
+		char c = toupper(*p);
+		if (c == '4' && p - callsign >= 2 && toupper(p[-2]) == 'K' && toupper(p[-1]) == 'G')
+			kg4 = true;
+		if (n && (n = find_child(n, c)) && n->prefix >= 0)
+			prefix = n->prefix;
+	}
 
-	// first look for a full callsign (prefixed with '=')
-	sstr[0] = '=';
-	dxcc_map_t::const_iterator entry = cmap->find(sstr);
-	if (entry != cmap->end())
-		return entry->second;
+	// a full callsign (prefixed with '=') wins
+	if (n && n->exact >= 0)
+		return &(*entries)[n->exact];
 
-	// erase the '=' and do a longest prefix search
-	sstr.erase(0, 1);
-	size_t len = sstr.length();
 // accomodate special case for KG4... calls
 // all two letter suffix KG4 calls are Guantanamo
 // all others are US non Guantanamo
-	if (sstr.find("KG4") != string::npos) {
-		if (len == 4 || len == 6) {
-			sstr = "K";
-			len = 1;
-		}
-	}
-	do {
-		sstr.resize(len--);
-		if ((entry = cmap->find(sstr)) != cmap->end())
-			return entry->second;
-	} while (len);
-
-	return NULL;
-}
-
-static void add_prefix(string& prefix, dxcc* entry)
-{
-	string::size_type i = prefix.find_first_of("([<{");
-	if (likely(i == string::npos)) {
-		(*cmap)[prefix] = entry;
-		return;
+	size_t len = p - callsign;
+	if (kg4 && (len == 4 || len == 6)) {
+		n = find_child(nodes, 'K');
+		return n && n->prefix >= 0 ? &(*entries)[n->prefix] : NULL;
 	}
 
-	string::size_type j = i, first = i;
-	do {
-		entry = new struct dxcc(*entry);
-		switch (prefix[i++]) { // increment i past opening bracket
-		case '(':
-			if ((j = prefix.find(')', i)) == string::npos) {
-				delete entry;
-				return;
-			}
-			prefix[j] = '\0';
-			entry->cq_zone = atoi(prefix.data() + i);
-			break;
-		case '[':
-			if ((j = prefix.find(']', i)) == string::npos) {
-				delete entry;
-				return;
-			}
-			prefix[j] = '\0';
-			entry->itu_zone = atoi(prefix.data() + i);
-			break;
-		case '<':
-			if ((j = prefix.find('/', i)) == string::npos) {
-				delete entry;
-				return;
-			}
-			prefix[j] = '\0';
-			entry->latitude = atof(prefix.data() + i);
-			if ((j = prefix.find('>', j)) == string::npos) {
-				delete entry;
-				return;
-			}
-			prefix[j] = '\0';
-			entry->longitude = atof(prefix.data() + i);
-			break;
-		case '{':
-			if ((j = prefix.find('}', i)) == string::npos) {
-				delete entry;
-				return;
-			}
-			memcpy(entry->continent, prefix.data() + i, 2);
-			break;
-		}
-	} while ((i = prefix.find_first_of("([<{", j)) != string::npos);
-
-	prefix.erase(first);
-	(*cmap)[prefix] = entry;
+	return prefix >= 0 ? &(*entries)[prefix] : NULL;
 }
 
 typedef unordered_map<string, unsigned char> qsl_map_t;
@@ -61,6 +61,7 @@
 #include "wefax.h"
 #include "wefax-pic.h"
 #include "navtex.h"
+#include "view_cw.h"
 
 #if USE_HAMLIB
         #include "hamlib.h"
@@ -2463,6 +2464,33 @@ public:
 	}
 };
 
+class Spot_cw_get_channels : public xmlrpc_c::method
+{
+public:
+	Spot_cw_get_channels()
+	{
+		_signature = "A:n";
+		_help = "Returns the active CW browser channels as an array of structs "
+			"with the audio frequency, speed (WPM) and latest decoded text.";
+	}
+	void execute(const xmlrpc_c::paramList& params, xmlrpc_c::value* retval)
+	{
+		vector<xmlrpc_c::value> channels;
+		if (cwviewer) {
+			vector<view_cw::channel_info> info;
+			cwviewer->get_channels(info);
+			for (size_t i = 0; i < info.size(); i++) {
+				map<string, xmlrpc_c::value> item;
+				item["frequency"] = xmlrpc_c::value_int(info[i].frequency);
+				item["wpm"] = xmlrpc_c::value_int(info[i].wpm);
+				item["text"] = xmlrpc_c::value_string(info[i].text);
+				channels.push_back(xmlrpc_c::value_struct(item));
+			}
+		}
+		*retval = xmlrpc_c::value_array(channels);
+	}
+};
+
 // =============================================================================
 
 // Returns the current wefax modem pointer.
@@ -2870,6 +2898,7 @@ struct Navtex_send_message : public xmlrpc_c::method
 	ELEM_(Spot_set_auto, "spot.set_auto")							\
 	ELEM_(Spot_toggle_auto, "spot.toggle_auto")						\
 	ELEM_(Spot_pskrep_get_count, "spot.pskrep.get_count")			\
+	ELEM_(Spot_cw_get_channels, "spot.cw.get_channels")				\
 																		\
 	ELEM_(Wefax_state_string, "wefax.state_string")						\
 	ELEM_(Wefax_skip_apt, "wefax.skip_apt")								\
@@ -181,14 +181,10 @@ int mt63::rx_process(const double *buf, int len)
 	static char msg1[20];
 	static char msg2[20];
 
-	if (Interleave != progdefaults.mt63_interleave) {
-		Interleave = progdefaults.mt63_interleave;
-		restart();
-	}
-	if (long_integral != progdefaults.mt63_rx_integration) {
-		long_integral = progdefaults.mt63_rx_integration;
-		restart();
-	}
+	if (rx_params_changed() &&
+		(Interleave != rxp.mt63_interleave ||
+		long_integral != rxp.mt63_rx_integration))
+			restart(&rxp);
 
 	if (InpBuff->EnsureSpace(len) == -1) {
 		fprintf(stderr, "mt63_rxprocess: buffer error\n");
@@ -226,7 +222,7 @@ int mt63::rx_process(const double *buf, int len)
 	for (i = 0; i < Rx->Output.Len; i++) {
 		c = Rx->Output.Data[i];
 
-		if (!progdefaults.mt63_8bit) {
+		if (!rxp.mt63_8bit) {
 			put_rx_char(c);
 			continue;
 		}
@@ -274,7 +270,7 @@ void mt63::rx_flush()
 	while (Rx->SYNC_LockStatus()) {
 		for (int i = 0; i < dlen; i++) {
 			c = Rx->Output.Data[i];
-			if (!progdefaults.mt63_8bit) {
+			if (!rxp.mt63_8bit) {
 				put_rx_char(c);
 				continue;
 			}
@@ -302,10 +298,20 @@ void mt63::rx_flush()
 	return;
 }
 
-void mt63::restart()
+// the receive path passes its block snapshot, everything else reads the
+// current configuration
+void mt63::restart(const rx_params* p)
 {
 	int err;
 
+	if (p) {
+		Interleave = p->mt63_interleave;
+		long_integral = p->mt63_rx_integration;
+	} else {
+		Interleave = progdefaults.mt63_interleave;
+		long_integral = progdefaults.mt63_rx_integration;
+	}
+
 	put_MODEstatus(mode);
 	set_scope_mode(Digiscope::BLANK);
 
@@ -30,6 +30,7 @@
 #include <memory.h>
 #include <assert.h>
 
+#include <algorithm>
 #include <list>
 #include <vector>
 #include <string>
@@ -255,10 +256,91 @@ public:
 
 class NavtexCatalog
 {
-	// TODO: Consider a multimap<char, NavtexRecord>
-	typedef std::deque< NavtexRecord > CatalogType ;
+	typedef std::vector< NavtexRecord > CatalogType ;
 	CatalogType m_catalog ;
 
+	// A station as a point on the unit sphere: the nearest by chord
+	// is also the nearest by great circle distance.
+	struct Point {
+		double m_xyz[3];
+		size_t m_idx ; // In m_catalog.
+
+		Point( const CoordinateT::Pair & coo, size_t idx ) : m_idx(idx) {
+			double lon = coo.longitude().angle() * M_PI / 180.0 ;
+			double lat = coo.latitude().angle() * M_PI / 180.0 ;
+			m_xyz[0] = cos(lat) * cos(lon);
+			m_xyz[1] = cos(lat) * sin(lon);
+			m_xyz[2] = sin(lat);
+		}
+
+		double dist2( const Point & a ) const {
+			double dx = m_xyz[0] - a.m_xyz[0];
+			double dy = m_xyz[1] - a.m_xyz[1];
+			double dz = m_xyz[2] - a.m_xyz[2];
+			return dx * dx + dy * dy + dz * dz ;
+		}
+	};
+
+	struct AxisLess {
+		int m_axis ;
+		AxisLess( int axis ) : m_axis(axis) {}
+		bool operator()( const Point & a, const Point & b ) const {
+			return a.m_xyz[m_axis] < b.m_xyz[m_axis];
+		}
+	};
+
+	// One implicit kd-tree per origin letter: the median of each range is
+	// the node, the lower and upper halves are its subtrees.
+	typedef std::vector< Point > TreeType ;
+	TreeType m_trees[256];
+
+	static void build( TreeType & tree, size_t beg, size_t end, int depth )
+	{
+		if( end - beg <= 1 ) return ;
+		size_t mid = ( beg + end ) / 2 ;
+		std::nth_element( tree.begin() + beg, tree.begin() + mid, tree.begin() + end, AxisLess( depth % 3 ) );
+		build( tree, beg, mid, depth + 1 );
+		build( tree, mid + 1, end, depth + 1 );
+	}
+
+	struct Query {
+		Point  m_target ;
+		double m_freq ;
+		bool   m_okFreq ;
+		size_t m_best ;
+		double m_bestDist2 ;
+	};
+
+	void search( const TreeType & tree, size_t beg, size_t end, int depth, Query & qry ) const
+	{
+		if( beg >= end ) return ;
+		size_t mid = ( beg + end ) / 2 ;
+		const Point & pnt = tree[mid];
+
+		bool freqClose = freq_close( qry.m_freq, m_catalog[pnt.m_idx].frequency() );
+		if( ! qry.m_okFreq || freqClose ) {
+			double dist2 = qry.m_target.dist2( pnt );
+			// On a tie, the first station of the file wins.
+			if( ( dist2 < qry.m_bestDist2 )
+			|| ( ( dist2 == qry.m_bestDist2 ) && ( pnt.m_idx < qry.m_best ) ) ) {
+				qry.m_best = pnt.m_idx ;
+				qry.m_bestDist2 = dist2 ;
+			}
+		}
+
+		int axis = depth % 3 ;
+		double diff = qry.m_target.m_xyz[axis] - pnt.m_xyz[axis];
+		if( diff < 0 ) {
+			search( tree, beg, mid, depth + 1, qry );
+			if( diff * diff <= qry.m_bestDist2 )
+				search( tree, mid + 1, end, depth + 1, qry );
+		} else {
+			search( tree, mid + 1, end, depth + 1, qry );
+			if( diff * diff <= qry.m_bestDist2 )
+				search( tree, beg, mid, depth + 1, qry );
+		}
+	}
+
 	static bool freq_close( double freqA, double freqB )
 	{
 		static const double freq_ratio = 1.1 ;
@@ -272,8 +354,6 @@ class NavtexCatalog
 		||	freq_close( freq, 4209.5 );
 	}
 
-	typedef std::multimap< double, CatalogType::const_iterator > SolutionType ;
-
 	static const NavtexRecord & dflt_solution(void) {
 		static const NavtexRecord dfltNavtex ;
 		return dfltNavtex ;
@@ -297,6 +377,14 @@ class NavtexCatalog
 			m_catalog.push_back( tmp );
 		}
 		ifs.close();
+
+		for( size_t i = 0; i < m_catalog.size(); ++i ) {
+			TreeType & tree = m_trees[ (unsigned char)m_catalog[i].origin() ];
+			tree.push_back( Point( m_catalog[i].coordinates(), i ) );
+		}
+		for( size_t i = 0; i < sizeof(m_trees) / sizeof(m_trees[0]); ++i ) {
+			build( m_trees[i], 0, m_trees[i].size(), 0 );
+		}
 	}
 
 	static const NavtexCatalog & inst() {
@@ -312,24 +400,17 @@ public:
 		char origin,
 		const CoordinateT::Pair & coo )
 	{
-		SolutionType sol;
-
-		double freq = freq_ll / 1000.0 ; // As kiloHertz in the data file.
+		const NavtexCatalog & cat = inst();
+		const TreeType & tree = cat.m_trees[ (unsigned char)origin ];
 
-		bool okFreq = freq_acceptable( freq );
+		Query qry = { Point( coo, 0 ), 0.0, false, 0, HUGE_VAL };
+		qry.m_freq = freq_ll / 1000.0 ; // As kiloHertz in the data file.
+		qry.m_okFreq = freq_acceptable( qry.m_freq );
+		qry.m_best = cat.m_catalog.size();
 
-		for( CatalogType::const_iterator it = inst().m_catalog.begin(), en = inst().m_catalog.end(); it != en ; ++it )
-		{
-			if( origin != it->origin() ) continue ;
+		cat.search( tree, 0, tree.size(), 0, qry );
 
-			bool freqClose = freq_close( freq, it->frequency() );
-			if( okFreq && ! freqClose ) continue ;
-
-			double dist = coo.distance( it->coordinates() );
-			sol.insert( SolutionType::value_type( dist, it ) );
-		}
-		
-		return sol.empty() ? dflt_solution() : *( sol.begin()->second );
+		return qry.m_best == cat.m_catalog.size() ? dflt_solution() : cat.m_catalog[ qry.m_best ];
 	}
 
 	static const NavtexRecord & Find(
@@ -465,6 +546,36 @@ public:
 		m_y1 = y;
 		return (y);
 	}
+
+	// Copy of the coefficients and state, for block processing: being
+	// local, it lives in registers, and several of them can be stepped in
+	// the same loop so that their recursions run in parallel.
+	struct Block {
+		double b0, b1, b2, a1, a2;
+		double x1, x2, y1, y2;
+
+		Block( const BiQuadraticFilter & f )
+		: b0(f.m_b0), b1(f.m_b1), b2(f.m_b2), a1(f.m_a1), a2(f.m_a2)
+		, x1(f.m_x1), x2(f.m_x2), y1(f.m_y1), y2(f.m_y2) {}
+
+		double filter(double x) {
+			// Only the last product waits for the previous output.
+			double yy = ( b0 * x + b1 * x1 + b2 * x2 - a2 * y2 ) - a1 * y1;
+			x2 = x1;
+			x1 = x;
+			y2 = y1;
+			y1 = yy;
+			return yy;
+		}
+	};
+
+	void save( const Block & blk ) {
+		m_x1 = blk.x1;
+		m_x2 = blk.x2;
+		m_y1 = blk.y1;
+		m_y2 = blk.y2;
+		y = blk.y1;
+	}
 };
 
 static const unsigned char code_to_ltrs[128] = {
@@ -850,6 +961,9 @@ class navtex_implementation {
 	BiQuadraticFilter	  m_biquad_mark;
 	BiQuadraticFilter	  m_biquad_space;
 	BiQuadraticFilter	  m_biquad_lowpass;
+	std::vector<double>	   m_blk_logic, m_blk_average;
+	int					m_bit_phase;
+	bool				   m_signal_lost;
 	int					m_bit_sample_count, m_half_bit_sample_count;
 	State				  m_state;
 	int					m_sample_count;
@@ -858,7 +972,6 @@ class navtex_implementation {
 	int					m_code_bits;
 	bool				   m_shift ;
 	bool				   m_inverse ;
-	bool				   m_pulse_edge_event;
 	int					m_error_count;
 	int					m_valid_count;
 	double				 m_sync_delta;
@@ -896,11 +1009,12 @@ public:
 		double m_bit_duration_seconds = 1.0 / m_baud_rate;
 		m_bit_sample_count = (int) (m_sample_rate * m_bit_duration_seconds + 0.5);
 		m_half_bit_sample_count = m_bit_sample_count / 2;
-		m_pulse_edge_event = false;
 		m_error_count = 0;
 		m_valid_count = 0;
 		m_inverse = false;
 		m_sample_count = 0;
+		m_bit_phase = 0;
+		m_signal_lost = false;
 		m_next_event_count = 0;
 		m_zero_crossing_count = 0;
 		/// Maybe m_bit_sample_count is not a multiple of m_zero_crossings_divisor.
@@ -1191,188 +1305,235 @@ public:
 	void process_data(const double * data, int nb_samples) {
 		process_afc();
 		process_timeout();
-		for( int i =0; i < nb_samples; ++i ) {
-			short v = static_cast<short>(32767 * data[i]);
 
-			m_time_sec = m_sample_count / m_sample_rate ;
+		if( m_blk_logic.size() < (size_t)nb_samples ) {
+			m_blk_logic.resize( nb_samples );
+			m_blk_average.resize( nb_samples );
+		}
+		double * blk_logic = &m_blk_logic[0];
+		double * blk_average = &m_blk_average[0];
+
+		// The filters, the envelopes and the average level in one pass,
+		// all of their state in registers.
+		BiQuadraticFilter::Block mark( m_biquad_mark );
+		BiQuadraticFilter::Block space( m_biquad_space );
+		BiQuadraticFilter::Block lowpass( m_biquad_lowpass );
+		const double average_tc = m_audio_average_tc ;
+		const double average_keep = 1.0 - m_audio_average_tc ;
+		double audio_average = m_audio_average ;
+
+		for( int i = 0; i < nb_samples; ++i ) {
+			short v = static_cast<short>(32767 * data[i]);
 			double dv = v;
 
 			// separate mark and space by narrow filtering
-			double mark_level = m_biquad_mark.filter(dv);
-			double space_level = m_biquad_space.filter(dv);
+			double mark_abs = fabs( mark.filter(dv) );
+			double space_abs = fabs( space.filter(dv) );
 
-			double mark_abs = fabs(mark_level);
-			double space_abs = fabs(space_level);
+			audio_average = audio_average * average_keep + std::max(mark_abs, space_abs) * average_tc;
+			audio_average = std::max(.1, audio_average);
 
-			m_audio_average += (std::max(mark_abs, space_abs) - m_audio_average) * m_audio_average_tc;
-
-			m_audio_average = std::max(.1, m_audio_average);
-
-			// produce difference of absolutes of mark and space
-			double diffabs = (mark_abs - space_abs);
-
-			diffabs /= m_audio_average;
-
-			// now low-pass the resulting difference
-			double logic_level = m_biquad_lowpass.filter(diffabs);
+			// produce difference of absolutes of mark and space,
+			// then low-pass the resulting difference
+			blk_logic[i] = lowpass.filter( (mark_abs - space_abs) / audio_average );
+			blk_average[i] = audio_average;
+		}
 
-			bool mark_state = (logic_level > 0);
-			m_signal_accumulator += (mark_state) ? 1 : -1;
-			m_bit_duration++;
+		m_biquad_mark.save( mark );
+		m_biquad_space.save( space );
+		m_biquad_lowpass.save( lowpass );
+		m_audio_average = audio_average ;
+
+		// Bit clock: per sample, only the zero crossings are tracked. The
+		// decoder runs once per bit, at the center of each pulse.
+		double signal_accumulator = m_signal_accumulator ;
+		int bit_duration = m_bit_duration ;
+		bool old_mark_state = m_old_mark_state ;
+		int bit_phase = m_bit_phase ;
+		int sample_count = m_sample_count ;
+		int next_event_count = m_next_event_count ;
+		bool signal_lost = false ;
+
+		for( int i = 0; i < nb_samples; ++i, ++sample_count ) {
+			bool mark_state = (blk_logic[i] > 0);
+			signal_accumulator += (mark_state) ? 1 : -1;
+			bit_duration++;
+
+			if (blk_average[i] < m_audio_minimum) {
+				signal_lost = true ;
+			}
 
 			// adjust signal synchronization over time
 			// by detecting zero crossings
-			if (mark_state != m_old_mark_state) {
+			if (mark_state != old_mark_state) {
 				// a valid bit duration must be longer than bit duration / 2
-				if ((m_bit_duration % m_bit_sample_count) > m_half_bit_sample_count) {
+				if ((bit_duration % m_bit_sample_count) > m_half_bit_sample_count) {
 					// create a relative index for this zero crossing
-					assert( m_sample_count - m_next_event_count + m_bit_sample_count * 8 >= 0 );
-					size_t index = size_t((m_sample_count - m_next_event_count + m_bit_sample_count * 8) % m_bit_sample_count);
-
-					// TODO: This never happened so could be replaced by assert() for speed-up.
-					// Size = m_bit_sample_count / m_zero_crossings_divisor
-					if( index / m_zero_crossings_divisor >= m_zero_crossings.size() ) {
-						LOG_ERROR("index=%d m_zero_crossings_divisor=%d m_zero_crossings.size()=%d\n",
-								(int)index, m_zero_crossings_divisor, (int)m_zero_crossings.size() );
-						LOG_ERROR("m_sample_count=%d m_next_event_count=%d m_bit_sample_count=%d\n",
-						m_sample_count, m_next_event_count, m_bit_sample_count );
-						exit(EXIT_FAILURE);
-					}
-
-					m_zero_crossings.at( index / m_zero_crossings_divisor )++;
+					assert( sample_count - next_event_count + m_bit_sample_count * 8 >= 0 );
+					size_t index = size_t((sample_count - next_event_count + m_bit_sample_count * 8) % m_bit_sample_count);
+					assert( index / m_zero_crossings_divisor < m_zero_crossings.size() );
+					m_zero_crossings[ index / m_zero_crossings_divisor ]++;
 				}
-				m_bit_duration = 0;
+				bit_duration = 0;
 			}
-			m_old_mark_state = mark_state;
-			if (m_sample_count % m_bit_sample_count == 0) {
-				m_zero_crossing_count++;
-				static const int zero_crossing_samples = 16;
-				if (m_zero_crossing_count >= zero_crossing_samples) {
-					int best = 0;
-					int index = 0;
-					// locate max zero crossing
-					for (size_t i = 0; i < m_zero_crossings.size(); i++) {
-						int q = m_zero_crossings[i];
-						m_zero_crossings[i] = 0;
-						if (q > best) {
-							best = q;
-							index = i;
-						}
-					}
-					if (best > 0) { // if there is a basis for choosing
-						// create a signed correction value
-						index *= m_zero_crossings_divisor;
-						index = ((index + m_half_bit_sample_count) % m_bit_sample_count) - m_half_bit_sample_count;
-						// limit loop gain
-						double dbl_idx = (double)index / 8.0 ;
-						// m_sync_delta is a temporary value that is
-						// used once, then reset to zero
-						m_sync_delta = dbl_idx;
-						// m_baud_error is persistent -- used by baud error label
-						m_baud_error = dbl_idx;
-					}
-					m_zero_crossing_count = 0;
-				}
+			old_mark_state = mark_state;
+
+			if (bit_phase == 0) {
+				process_zero_crossings();
+			}
+			if (++bit_phase == m_bit_sample_count) {
+				bit_phase = 0;
 			}
 
 			// flag the center of signal pulses
-			m_pulse_edge_event = m_sample_count >= m_next_event_count;
-			if (m_pulse_edge_event) {
-				m_averaged_mark_state = (m_signal_accumulator > 0) ^ m_inverse;
-				m_signal_accumulator = 0;
+			if (sample_count >= next_event_count) {
+				m_averaged_mark_state = (signal_accumulator > 0) ^ m_inverse;
+				signal_accumulator = 0;
 				// set new timeout value, include zero crossing correction
-				m_next_event_count = m_sample_count + m_bit_sample_count + (int) (m_sync_delta + 0.5);
+				next_event_count = sample_count + m_bit_sample_count + (int) (m_sync_delta + 0.5);
 				m_sync_delta = 0;
+
+				m_time_sec = sample_count / m_sample_rate ;
+				process_bit( blk_average[i], signal_lost );
+				signal_lost = false ;
 			}
+		}
 
-			if (m_audio_average < m_audio_minimum) {
-				set_state(NOSIGNAL);
-			} else if (m_state == NOSIGNAL) {
-				set_state(SYNC_SETUP);
+		m_signal_accumulator = signal_accumulator ;
+		m_bit_duration = bit_duration ;
+		m_old_mark_state = old_mark_state ;
+		m_bit_phase = bit_phase ;
+		m_sample_count = sample_count ;
+		m_next_event_count = next_event_count ;
+		m_signal_lost = signal_lost ;
+
+		m_time_sec = m_sample_count / m_sample_rate ;
+		compute_metric();
+	}
+private:
+	void process_zero_crossings() {
+		m_zero_crossing_count++;
+		static const int zero_crossing_samples = 16;
+		if (m_zero_crossing_count >= zero_crossing_samples) {
+			int best = 0;
+			int index = 0;
+			// locate max zero crossing
+			for (size_t i = 0; i < m_zero_crossings.size(); i++) {
+				int q = m_zero_crossings[i];
+				m_zero_crossings[i] = 0;
+				if (q > best) {
+					best = q;
+					index = i;
+				}
+			}
+			if (best > 0) { // if there is a basis for choosing
+				// create a signed correction value
+				index *= m_zero_crossings_divisor;
+				index = ((index + m_half_bit_sample_count) % m_bit_sample_count) - m_half_bit_sample_count;
+				// limit loop gain
+				double dbl_idx = (double)index / 8.0 ;
+				// m_sync_delta is a temporary value that is
+				// used once, then reset to zero
+				m_sync_delta = dbl_idx;
+				// m_baud_error is persistent -- used by baud error label
+				m_baud_error = dbl_idx;
 			}
+			m_zero_crossing_count = 0;
+		}
+	}
+
+	/// Called at the center of each bit with the current average level.
+	void process_bit(double audio_average, bool signal_lost) {
+		// A restart asked for by the previous bit, or a loss of signal
+		// during this bit, happened before this bit's center.
+		signal_lost |= m_signal_lost ;
+		m_signal_lost = false;
+		bool restarted = ( m_state == SYNC_SETUP ) || signal_lost ;
+		if (signal_lost) {
+			set_state(NOSIGNAL);
+		}
+		if (audio_average < m_audio_minimum) {
+			set_state(NOSIGNAL);
+		} else if (m_state == NOSIGNAL) {
+			set_state(SYNC_SETUP);
+		}
 
-			switch (m_state) {
-				case NOSIGNAL: break;
-				case SYNC_SETUP:
-					m_bit_count = -1;
+		if (m_state == SYNC_SETUP) {
+			m_bit_count = -1;
+			m_code_bits = 0;
+			m_error_count = 0;
+			m_valid_count = 0;
+			m_shift = false;
+			m_sync_chrs.clear();
+			set_state(SYNC1);
+			if (!restarted) return;
+		}
+
+		switch (m_state) {
+			case NOSIGNAL: break;
+			case SYNC_SETUP: break;
+			// scan indefinitely for valid bit pattern
+			case SYNC1:
+				m_code_bits = (m_code_bits >> 1) | ( m_averaged_mark_state ? 64 : 0);
+				if (CCIR476::check_bits(m_code_bits)) {
+					m_sync_chrs.push_back(m_code_bits);
+					m_bit_count = 0;
 					m_code_bits = 0;
-					m_error_count = 0;
-					m_valid_count = 0;
-					m_shift = false;
-					m_sync_chrs.clear();
-					set_state(SYNC1);
-					break;
-				// scan indefinitely for valid bit pattern
-				case SYNC1:
-					if (m_pulse_edge_event) {
-						m_code_bits = (m_code_bits >> 1) | ( m_averaged_mark_state ? 64 : 0);
-						if (CCIR476::check_bits(m_code_bits)) {
-							m_sync_chrs.push_back(m_code_bits);
-							m_bit_count = 0;
-							m_code_bits = 0;
-							set_state(SYNC2);
-						}
-					}
-					break;
-				//  sample and validate bits in groups of 7
-				case SYNC2:
-					// find any bit alignment that produces a valid character
-					// then test that synchronization in subsequent groups of 7 bits
-					if (m_pulse_edge_event) {
-						m_code_bits = (m_code_bits >> 1) | ( m_averaged_mark_state ? 64 : 0);
-						m_bit_count++;
-						if (m_bit_count == 7) {
-							if (CCIR476::check_bits(m_code_bits)) {
-								m_sync_chrs.push_back(m_code_bits);
-								m_code_bits = 0;
-								m_bit_count = 0;
-								m_valid_count++;
-								// successfully read 4 characters?
-								if (m_valid_count == 4) {
-									for( sync_chrs_type::const_iterator it = m_sync_chrs.begin(), en = m_sync_chrs.end(); it != en; ++it ) {
-										process_char(*it);
-									}
-									set_state(READ_DATA);
-								}
-							} else { // failed subsequent bit test
-								m_code_bits = 0;
-								m_bit_count = 0;
-								// LOG_INFO("restarting sync");
-								set_state(SYNC_SETUP);
+					set_state(SYNC2);
+				}
+				break;
+			//  sample and validate bits in groups of 7
+			case SYNC2:
+				// find any bit alignment that produces a valid character
+				// then test that synchronization in subsequent groups of 7 bits
+				m_code_bits = (m_code_bits >> 1) | ( m_averaged_mark_state ? 64 : 0);
+				m_bit_count++;
+				if (m_bit_count == 7) {
+					if (CCIR476::check_bits(m_code_bits)) {
+						m_sync_chrs.push_back(m_code_bits);
+						m_code_bits = 0;
+						m_bit_count = 0;
+						m_valid_count++;
+						// successfully read 4 characters?
+						if (m_valid_count == 4) {
+							for( sync_chrs_type::const_iterator it = m_sync_chrs.begin(), en = m_sync_chrs.end(); it != en; ++it ) {
+								process_char(*it);
 							}
+							set_state(READ_DATA);
 						}
+					} else { // failed subsequent bit test
+						m_code_bits = 0;
+						m_bit_count = 0;
+						// LOG_INFO("restarting sync");
+						set_state(SYNC_SETUP);
 					}
-					break;
-				case READ_DATA:
-					if (m_pulse_edge_event) {
-						m_code_bits = (m_code_bits >> 1) | ( m_averaged_mark_state ? 64 : 0);
-						m_bit_count++;
-						if (m_bit_count == 7) {
-							if (m_error_count > 0) {
-								LOG_INFO(_("Error count: %d"), m_error_count);
-							}
-							if (process_char(m_code_bits)) {
-								if (m_error_count > 0) {
-									m_error_count--;
-								}
-							} else {
-								m_error_count++;
-								if (m_error_count > 2) {
-									LOG_INFO(_("Returning to sync"));
-									set_state(SYNC_SETUP);
-								}
-							}
-							m_bit_count = 0;
-							m_code_bits = 0;
+				}
+				break;
+			case READ_DATA:
+				m_code_bits = (m_code_bits >> 1) | ( m_averaged_mark_state ? 64 : 0);
+				m_bit_count++;
+				if (m_bit_count == 7) {
+					if (m_error_count > 0) {
+						LOG_INFO(_("Error count: %d"), m_error_count);
+					}
+					if (process_char(m_code_bits)) {
+						if (m_error_count > 0) {
+							m_error_count--;
+						}
+					} else {
+						m_error_count++;
+						if (m_error_count > 2) {
+							LOG_INFO(_("Returning to sync"));
+							set_state(SYNC_SETUP);
 						}
 					}
-					break;
-			}
-
-			m_sample_count++;
+					m_bit_count = 0;
+					m_code_bits = 0;
+				}
+				break;
 		}
-		compute_metric();
 	}
+public:
 
 	/// This updates the window label according to the state.
 	void set_label_from_state(void) const
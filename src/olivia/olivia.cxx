@@ -42,16 +42,6 @@ LOG_FILE_SOURCE(debug::LOG_MODEM);
 
 using namespace std;
 
-double olivia::nco(double freq)
-{
-    preamblephase += 2.0 * M_PI * freq / samplerate;
-
-	if (preamblephase > M_PI)
-		preamblephase -= 2.0 * M_PI;
-
-	return cos(preamblephase);
-}
-
 void olivia::tx_init(SoundBase *sc)
 {
 	unsigned char c;
@@ -101,13 +91,15 @@ void olivia::send_tones()
 		freqb = tone_midfreq + (tone_bw / 2.0); 
 	}
 
-	preamblephase = 0;
-	for (int i = 0; i < SR4; i++)
-		tonebuff[2*SR4 + i] = tonebuff[i] = nco(freqa) * ampshape[i];
+	preambleosc.reset();
+	preambleosc.set_freq(freqa, samplerate);
+	preambleosc.fill_cos(tonebuff, SR4, ampshape);
+	memcpy(&tonebuff[2*SR4], tonebuff, SR4 * sizeof(*tonebuff));
 
-	preamblephase = 0;
-	for (int i = 0; i < SR4; i++)
-		tonebuff[3*SR4 + i] = tonebuff[SR4 + i] = nco(freqb) * ampshape[i];
+	preambleosc.reset();
+	preambleosc.set_freq(freqb, samplerate);
+	preambleosc.fill_cos(&tonebuff[SR4], SR4, ampshape);
+	memcpy(&tonebuff[3*SR4], &tonebuff[SR4], SR4 * sizeof(*tonebuff));
 
 	for (int j = 0; j < TONE_DURATION; j += SCBLOCKSIZE)
 		ModulateXmtr(&tonebuff[j], SCBLOCKSIZE);
@@ -226,11 +218,12 @@ int olivia::rx_process(const double *buf, int len)
 	static char msg1[20];
 	static char msg2[20];
 
-	if (tones	!= progdefaults.oliviatones ||
-		bw 		!= progdefaults.oliviabw ||
-		smargin != progdefaults.oliviasmargin ||
-		sinteg	!= progdefaults.oliviasinteg )
-			restart();
+	if (rx_params_changed() &&
+		(tones	!= rxp.oliviatones ||
+		bw 		!= rxp.oliviabw ||
+		smargin != rxp.oliviasmargin ||
+		sinteg	!= rxp.oliviasinteg))
+			restart(&rxp);
 
 	int fc_offset = Tx->Bandwidth*(1.0 - 0.5/Tx->Tones)/2.0;
 
@@ -282,12 +275,21 @@ int olivia::rx_process(const double *buf, int len)
 	return 0;
 }
 
-void olivia::restart()
+// the receive path passes its block snapshot, everything else reads the
+// current configuration
+void olivia::restart(const rx_params* p)
 {
-	tones	= progdefaults.oliviatones;
-	bw 		= progdefaults.oliviabw;
-	smargin = progdefaults.oliviasmargin;
-	sinteg	= progdefaults.oliviasinteg;
+	if (p) {
+		tones	= p->oliviatones;
+		bw 		= p->oliviabw;
+		smargin = p->oliviasmargin;
+		sinteg	= p->oliviasinteg;
+	} else {
+		tones	= progdefaults.oliviatones;
+		bw 		= progdefaults.oliviabw;
+		smargin = progdefaults.oliviasmargin;
+		sinteg	= progdefaults.oliviasinteg;
+	}
 	
 	samplerate = 8000;
 	bandwidth = 125 * (1 << bw);
@@ -72,7 +72,7 @@ pskeval *evalpsk = (pskeval *)0;
 void psk::tx_init(SoundBase *sc)
 {
 	scard = sc;
-	phaseacc = 0;
+	txosc.reset();
 	prevsymbol = complex (1.0, 0.0);
 	preamble = dcdbits;
 	if (_pskr) {
@@ -988,7 +988,6 @@ int psk::rx_process(const double *buf, int len)
 
 void psk::tx_symbol(int sym)
 {
-	double delta;
 	double	ival, qval, shapeA, shapeB;
 	complex symbol;
 
@@ -1012,7 +1011,7 @@ void psk::tx_symbol(int sym)
 	}
 	symbol = prevsymbol * symbol;	// complex multiplication
 
-	delta = 2.0 * M_PI * get_txfreq_woffset() / samplerate;
+	txosc.set_freq(get_txfreq_woffset(), samplerate);
 
 	for (int i = 0; i < symbollen; i++) {
 
@@ -1022,11 +1021,8 @@ void psk::tx_symbol(int sym)
 		ival = shapeA * prevsymbol.real() + shapeB * symbol.real();
 		qval = shapeA * prevsymbol.imag() + shapeB * symbol.imag();
 
-		outbuf[i] = ival * cos(phaseacc) + qval * sin(phaseacc);
-
-		phaseacc += delta;
-		if (phaseacc > M_PI)
-			phaseacc -= 2.0 * M_PI;
+		outbuf[i] = ival * txosc.cos() + qval * txosc.sin();
+		txosc.step();
 	}
 
 	ModulateXmtr(outbuf, symbollen);
@@ -68,33 +68,62 @@ static long long	llFreq = 0;
 
 static bool nonCATrig = false;
 
+// PTT and QSY requests waiting for the port; the poll loop yields to them
+static volatile int	rigCAT_priority = 0;
+static pthread_cond_t	rigCAT_cond = PTHREAD_COND_INITIALIZER;
+
+struct rigCAT_urgent {
+	rigCAT_urgent() { __sync_fetch_and_add(&rigCAT_priority, 1); }
+	~rigCAT_urgent() {
+		__sync_fetch_and_sub(&rigCAT_priority, 1);
+		// have the poll loop read back the new state at once
+		pthread_mutex_lock(&rigCAT_mutex);
+		pthread_cond_signal(&rigCAT_cond);
+		pthread_mutex_unlock(&rigCAT_mutex);
+	}
+};
+
 static void *rigCAT_loop(void *args);
 
 #define RXBUFFSIZE 2000
 static unsigned char replybuff[RXBUFFSIZE+1];
+#ifdef __WOE32__
 static unsigned char retbuf[3];
+#endif
 
+// Send a command and read its reply.  The reply is read as it arrives and
+// the read returns as soon as the expected number of bytes (including the
+// echo of the command) is in; readafter, the worst case time for the rig
+// to answer, only bounds the wait for the first byte.  The Win32 port reads
+// with fixed 10 ms COMMTIMEOUTS and ignores Timeout(), so there we still
+// wait for the whole reply and then drain the port.
 bool sendCommand (string s, int retnbr)
 {
 	int numwrite = (int)s.length();
-	int readafter = progdefaults.RigCatWait;
+	int readafter;
+	int expected;
 	int numread;
 	int retval;
-	numread = retnbr;
-	if (progdefaults.RigCatECHO) numread += numwrite;
+	expected = retnbr;
+	if (progdefaults.RigCatECHO) expected += numwrite;
+	expected = MIN(expected, RXBUFFSIZE);
 	readafter =
 		progdefaults.RigCatWait + (int) ceilf (
-			numread * (9 + progdefaults.RigCatStopbits) *
+			expected * (9 + progdefaults.RigCatStopbits) *
 			1000.0 / rigio.Baud() );
 
 	LOG_DEBUG("%s", str2hex(s.data(), s.length()));
 
+// discard anything left over from an earlier, failed exchange
+	rigio.FlushBuffer();
+
 	retval = rigio.WriteBuffer((unsigned char *)s.c_str(), numwrite);
 	if (retval <= 0)
 		LOG_VERBOSE("Write error %d", retval);
 
 	memset(replybuff, 0, RXBUFFSIZE + 1);
 	numread = 0;
+#ifdef __WOE32__
 	MilliSleep( readafter );
 	while (numread < RXBUFFSIZE) {
 		memset(retbuf, 0, 2);
@@ -102,6 +131,19 @@ bool sendCommand (string s, int retnbr)
 		replybuff[numread] = retbuf[0];
 		numread++;
 	}
+#else
+	if (expected) {
+		int tmo = rigio.Timeout();
+		rigio.Timeout(readafter + tmo);
+		numread = rigio.ReadBuffer(replybuff, expected);
+// pick up whatever else the rig has already sent, without waiting
+		if (numread == expected) {
+			rigio.Timeout(0);
+			numread += rigio.ReadBuffer(replybuff + numread, RXBUFFSIZE - numread);
+		}
+		rigio.Timeout(tmo);
+	}
+#endif
 	LOG_DEBUG("reply %s", str2hex(replybuff, numread));
 	if (numread > retnbr) {
 		memmove(replybuff, replybuff + numread - retnbr, retnbr);
@@ -405,6 +447,7 @@ retry_get_freq: ;
 
 void rigCAT_setfreq(long long f)
 {
+	rigCAT_urgent urgent;
 	XMLIOS modeCmd;
 	list<XMLIOS>::iterator itrCmd;
 	string strCmd;
@@ -816,6 +859,7 @@ void rigCAT_setwidth(const string& w)
 
 void rigCAT_pttON()
 {
+	rigCAT_urgent urgent;
 	XMLIOS modeCmd;
 	list<XMLIOS>::iterator itrCmd;
 	string strCmd;
@@ -870,6 +914,7 @@ void rigCAT_pttON()
 
 void rigCAT_pttOFF()
 {
+	rigCAT_urgent urgent;
 	XMLIOS modeCmd;
 	list<XMLIOS>::iterator itrCmd;
 	string strCmd;
@@ -1142,6 +1187,7 @@ void rigCAT_close(void)
 
 	pthread_mutex_lock(&rigCAT_mutex);
 		rigCAT_exit = true;
+		pthread_cond_signal(&rigCAT_cond);
 	pthread_mutex_unlock(&rigCAT_mutex);
 
 	if (!rigCAT_thread) return;
@@ -1212,7 +1258,11 @@ static void *rigCAT_loop(void *args)
 	bool failed;
 
 	for (;;) {
-		MilliSleep(200);
+// wait for the next poll, or until a PTT or QSY request has completed
+		pthread_mutex_lock(&rigCAT_mutex);
+			if (rigCAT_exit == false)
+				pthread_cond_timedwait_rel(&rigCAT_cond, &rigCAT_mutex, 0.2);
+		pthread_mutex_unlock(&rigCAT_mutex);
 
 		if (rigCAT_exit == true)
 			break;
@@ -1220,17 +1270,25 @@ static void *rigCAT_loop(void *args)
 		if (rigCAT_bypass == true)
 			continue;
 
+// PTT and QSY requests go first; each of them signals us when done
+		if (rigCAT_priority)
+			continue;
+
 		pthread_mutex_lock(&rigCAT_mutex);
 			freq = rigCAT_getfreq(progdefaults.RigCatRetries, failed);
 		pthread_mutex_unlock(&rigCAT_mutex);
 
-		pthread_mutex_lock(&rigCAT_mutex);
-			sWidth = rigCAT_getwidth();
-		pthread_mutex_unlock(&rigCAT_mutex);
+		if (!rigCAT_priority) {
+			pthread_mutex_lock(&rigCAT_mutex);
+				sWidth = rigCAT_getwidth();
+			pthread_mutex_unlock(&rigCAT_mutex);
+		}
 
-		pthread_mutex_lock(&rigCAT_mutex);
-			sMode = rigCAT_getmode();
-		pthread_mutex_unlock(&rigCAT_mutex);
+		if (!rigCAT_priority) {
+			pthread_mutex_lock(&rigCAT_mutex);
+				sMode = rigCAT_getmode();
+			pthread_mutex_unlock(&rigCAT_mutex);
+		}
 
 		if ((freq > 0) && (freq != llFreq)) {
 			llFreq = freq;
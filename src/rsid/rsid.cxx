@@ -282,8 +282,6 @@ cRsId::cRsId()
 
 	rsfft = new Cfft(RSID_FFT_SIZE);
 
-	memset(aHashTable1, 255, sizeof(aHashTable1));
-	memset(aHashTable2, 255, sizeof(aHashTable2));
 	memset(fftwindow, 0, RSID_ARRAY_SIZE * sizeof(double));
 //	BlackmanWindow(fftwindow, RSID_FFT_SIZE);
 //	HammingWindow(fftwindow, RSID_FFT_SIZE);
@@ -294,17 +292,20 @@ cRsId::cRsId()
 	memset(pCodes, 0, rsid_ids_size * RSID_NSYMBOLS);
 
 	// Initialization  of assigned mode/submode IDs.
-	// HashTable is used for finding a code with lowest Hamming distance.
-	unsigned char* c;
-	int hash1, hash2;
-	for (int i = 0; i < rsid_ids_size; i++) {
-		c = pCodes + i * RSID_NSYMBOLS;
-		Encode(rsid_ids[i].rs, c);
-		hash1 = c[11] | (c[12] << 4);
-		hash2 = c[13] | (c[14] << 4);
-		aHashTable1[hash1] = i;
-		aHashTable2[hash2] = i;
-	}
+	for (int i = 0; i < rsid_ids_size; i++)
+		Encode(rsid_ids[i].rs, pCodes + i * RSID_NSYMBOLS);
+
+	// The indices are used for finding the codes with lowest Hamming
+	// distance.  A code with at most one symbol error always matches
+	// one of the two symbol pairs, so only the codes listed under the
+	// received pairs need to be verified.
+	aHashCodes1 = new unsigned short[rsid_ids_size];
+	aHashCodes2 = new unsigned short[rsid_ids_size];
+	BuildIndex(aHashStart1, aHashCodes1, 11);
+	BuildIndex(aHashStart2, aHashCodes2, 13);
+
+	decimator = 0;
+	decimate_ratio = 1;
 
 	nBinLow = RSID_RESOL + 1;
 	nBinHigh = RSID_FFT_SIZE - 32;
@@ -316,7 +317,10 @@ cRsId::cRsId()
 cRsId::~cRsId()
 {
 	delete [] pCodes;
+	delete [] aHashCodes1;
+	delete [] aHashCodes2;
 	delete [] outbuf;
+	delete decimator;
 	src_delete(src_state);
 }
 
@@ -335,6 +339,9 @@ void cRsId::reset()
 		LOG_ERROR("src_reset error %d: %s", error, src_strerror(error));
 	src_data.src_ratio = 0.0;
 	inptr = aInputSamples + RSID_FFT_SAMPLES;
+
+	// forces the decimator to be rebuilt on the next receive()
+	decimate_ratio = 0;
 }
 
 void cRsId::Encode(int code, unsigned char *rsid)
@@ -351,6 +358,41 @@ void cRsId::Encode(int code, unsigned char *rsid)
 	}
 }
 
+// Build an inverted index on the symbol pair (sym, sym + 1) of every code
+void cRsId::BuildIndex(unsigned short *start, unsigned short *codes, int sym)
+{
+	unsigned char* c;
+	int hash;
+
+	memset(start, 0, (RSID_HASH_LEN + 1) * sizeof(*start));
+	for (int i = 0; i < rsid_ids_size; i++) {
+		c = pCodes + i * RSID_NSYMBOLS;
+		hash = c[sym] | (c[sym + 1] << 4);
+		start[hash + 1]++;
+	}
+	for (int i = 0; i < RSID_HASH_LEN; i++)
+		start[i + 1] += start[i];
+
+	unsigned short fill[RSID_HASH_LEN];
+	memcpy(fill, start, sizeof(fill));
+	for (int i = 0; i < rsid_ids_size; i++) {
+		c = pCodes + i * RSID_NSYMBOLS;
+		hash = c[sym] | (c[sym + 1] << 4);
+		codes[fill[hash]++] = i;
+	}
+}
+
+void cRsId::setup_decimator(int ratio)
+{
+	delete decimator;
+	decimator = 0;
+	decimate_ratio = ratio;
+	if (ratio > 1) {
+		// cut off just below the RSID Nyquist frequency
+		decimator = new C_FIR_filter();
+		decimator->init_lowpass(RSID_DECIM_FIRLEN, ratio, 0.45 / ratio);
+	}
+}
 
 void cRsId::CalculateBuckets(const double *pSpectrum, int iBegin, int iEnd)
 {
@@ -384,10 +426,19 @@ void cRsId::CalculateBuckets(const double *pSpectrum, int iBegin, int iEnd)
 
 void cRsId::receive(const float* buf, size_t len)
 {
-	double src_ratio = RSID_SAMPLE_RATE / active_modem->get_samplerate();
+	int samplerate = active_modem->get_samplerate();
+	double src_ratio = RSID_SAMPLE_RATE / samplerate;
 	bool resample = (fabs(src_ratio - 1.0) >= DBL_EPSILON);
 	size_t ns;
 
+	// An exact integer multiple of the RSID rate only needs a low pass
+	// that computes one output for every decimate_ratio inputs.
+	int ratio = samplerate % (int)RSID_SAMPLE_RATE ? 1 : samplerate / (int)RSID_SAMPLE_RATE;
+	if (ratio != decimate_ratio)
+		setup_decimator(ratio);
+	if (decimator)
+		resample = false;
+
 	while (len) {
 		ns = inptr - aInputSamples;
 		if (ns >= RSID_FFT_SAMPLES) // inptr points to second half of aInputSamples
@@ -411,8 +462,18 @@ void cRsId::receive(const float* buf, size_t len)
 			buf += src_data.input_frames_used;
 			len -= src_data.input_frames_used;
 		}
+		else if (decimator) {
+			double out;
+			while (len && ns) {
+				if (decimator->Irun(*buf, out)) {
+					*inptr++ = out;
+					ns--;
+				}
+				buf++;
+				len--;
+			}
+		}
 		else {
-
 			ns = MIN(ns, len);
 			memcpy(inptr, buf, ns * sizeof(*inptr));
 			inptr += ns;
@@ -785,11 +846,26 @@ int cRsId::HammingDistance(int iBucket, unsigned char *p2)
 	return dist;
 }
 
+// Verify every code indexed under key against the buckets of iBucket
+void cRsId::check_candidates(int iBucket, int key, const unsigned short *start,
+			const unsigned short *codes, int &iDistanceMin, int &iSymbol, int &iBin)
+{
+	int j, iDistance;
+	for (int n = start[key]; n < start[key + 1]; n++) {
+		j = codes[n];
+		iDistance = HammingDistance(iBucket, pCodes + j * RSID_NSYMBOLS);
+		if (iDistance < 2 && iDistance < iDistanceMin) {
+			iDistanceMin = iDistance;
+			iSymbol		 = rsid_ids[j].rs;
+			iBin		 = iBucket;
+		}
+	}
+}
+
 bool cRsId::search_amp( int &SymbolOut,	int &BinOut)
 {
-	int i, j;
+	int i, key;
 	int iDistanceMin = 99;  // infinity
-	int iDistance;
 	int iBin		 = -1;
 	int iSymbol		 = -1;
 	int iEnd		 = nBinHigh - RSID_NTIMES;//30;
@@ -815,24 +891,12 @@ bool cRsId::search_amp( int &SymbolOut,	int &BinOut)
 	CalculateBuckets ( aFFTAmpl, nBinLow + 1, iEnd);//nBinHigh - 30);
 
 	for (i = nBinLow; i < iEnd; ++ i) {
-		j = aHashTable1[aBuckets[i1][i] | (aBuckets[i2][i] << 4)];
-		if (j < rsid_ids_size)  { //!= 255) {
-			iDistance = HammingDistance(i, pCodes + j * RSID_NSYMBOLS);
-			if (iDistance < 2 && iDistance < iDistanceMin) {
-				iDistanceMin = iDistance;
-				iSymbol  	 = rsid_ids[j].rs;
-				iBin		 = i;
-			}
-		}
-		j = aHashTable2[aBuckets[i3][i] | (aBuckets[iTime][i] << 4)];
-		if (j < rsid_ids_size)  { //!= 255) {
-			iDistance = HammingDistance (i, pCodes + j * RSID_NSYMBOLS);
-			if (iDistance < 2 && iDistance < iDistanceMin) {
-				iDistanceMin = iDistance;
-				iSymbol		 = rsid_ids[j].rs;
-				iBin		 = i;
-			}
-		}
+		key = aBuckets[i1][i] | (aBuckets[i2][i] << 4);
+		if (aHashStart1[key] != aHashStart1[key + 1])
+			check_candidates(i, key, aHashStart1, aHashCodes1, iDistanceMin, iSymbol, iBin);
+		key = aBuckets[i3][i] | (aBuckets[iTime][i] << 4);
+		if (aHashStart2[key] != aHashStart2[key + 1])
+			check_candidates(i, key, aHashStart2, aHashCodes2, iDistanceMin, iSymbol, iBin);
 	}
 
 	if (iSymbol == -1) {
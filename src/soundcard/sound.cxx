@@ -86,6 +86,8 @@ SoundBase::SoundBase()
 	  txppm(progdefaults.TX_corr), rxppm(progdefaults.RX_corr),
           tx_src_state(0), rx_src_state(0),
           wrt_buffer(new double[SND_BUF_LEN]),
+	  tx_route(TX_ROUTE_LEFT), tx_reverse(false), tx_channels(2),
+	  tx_level(0.0), tx_gain(1.0f),
 #if USE_SNDFILE
           ofCapture(0), ifPlayback(0), ofGenerate(0),
 #endif
@@ -108,6 +110,75 @@ SoundBase::~SoundBase()
 #endif
 }
 
+// Set the transmit level in dB; the gain is only recomputed when it changes
+void SoundBase::set_txlevel(double dB)
+{
+	if (dB == tx_level)
+		return;
+	tx_level = dB;
+	tx_gain = pow(10, dB / 20.0);
+}
+
+// Decide where the transmit signal goes.  Called when an output stream is
+// opened, so that the sample loops below do not test the settings, and
+// again (without arguments) when the channel options change, since the
+// channel count of the open stream stays the same.
+void SoundBase::tx_route_update(unsigned channels)
+{
+	tx_channels = channels;
+	if (channels == 1)
+		tx_route = TX_ROUTE_MONO;
+	else if (progdefaults.sig_on_right_channel)
+		tx_route = TX_ROUTE_BOTH;
+	else if (progdefaults.ReverseAudio)
+		tx_route = TX_ROUTE_RIGHT;
+	else
+		tx_route = TX_ROUTE_LEFT;
+	tx_reverse = progdefaults.ReverseAudio;
+}
+
+// Convert, scale and route count frames into out
+void SoundBase::tx_interleave(float* out, const double* in, size_t count)
+{
+	const float g = tx_gain;
+
+	switch (tx_route) {
+	case TX_ROUTE_MONO:
+		for (size_t i = 0; i < count; i++)
+			out[i] = g * in[i];
+		break;
+	case TX_ROUTE_BOTH:
+		for (size_t i = 0; i < count; i++)
+			out[2*i] = out[2*i + 1] = g * in[i];
+		break;
+	case TX_ROUTE_LEFT:
+		for (size_t i = 0; i < count; i++) {
+			out[2*i] = g * in[i];
+			out[2*i + 1] = 0.0f;
+		}
+		break;
+	case TX_ROUTE_RIGHT:
+		for (size_t i = 0; i < count; i++) {
+			out[2*i] = 0.0f;
+			out[2*i + 1] = g * in[i];
+		}
+		break;
+	}
+}
+
+// As above for a signal and a right channel (PTT tone) that is not scaled
+void SoundBase::tx_interleave_stereo(float* out, const double* left, const double* right, size_t count)
+{
+	const float g = tx_gain;
+	float* l = out + (tx_reverse ? 1 : 0);
+	float* r = out + (tx_reverse ? 0 : 1);
+
+	for (size_t i = 0; i < count; i++) {
+		l[2*i] = g * left[i];
+		r[2*i] = right[i];
+	}
+}
+
 #if USE_SNDFILE
 void SoundBase::get_file_params(const char* def_fname, const char** fname, int* format)
 {
@@ -254,15 +325,19 @@ sf_count_t SoundBase::read_file(SNDFILE* file, float* buf, size_t count)
 	return r;
 }
 
-#define WRITE_FILE(type_, file_, buf_, count_)					\
-	if (capture || !progdefaults.EnableMixer)				\
+#define WRITE_FILE(type_, file_, buf_, count_, gain_)				\
+	type_ mult = gain_;							\
+	if (!capture && progdefaults.EnableMixer)				\
+		mult *= progStatus.XmtMixer;					\
+	if (mult == 1.0)							\
 		return sf_writef_ ## type_(file, buf, count);			\
-	/* generated audio; apply transmit mixer level */			\
+	/* generated audio; apply transmit level and mixer level */		\
 	size_t nw = count;							\
 	type_* wrtbuf = (type_*)wrt_buffer;					\
-	for (size_t n = MIN(SND_BUF_LEN, count); count; count -= n) {		\
+	for (size_t n = MIN(SND_BUF_LEN, count); count; count -= n, buf += n) {	\
+		n = MIN(SND_BUF_LEN, count);					\
 		for (size_t i = 0; i < n; i++)					\
-			wrtbuf[i] = buf[i] * progStatus.XmtMixer;		\
+			wrtbuf[i] = buf[i] * mult;				\
 		if (sf_writef_ ## type_(file, wrtbuf, n) != (sf_count_t)n) {	\
 			LOG_ERROR("sf_write error: %s", sf_strerror(file));	\
 			break;							\
@@ -273,12 +348,12 @@ sf_count_t SoundBase::read_file(SNDFILE* file, float* buf, size_t count)
 
 sf_count_t SoundBase::write_file(SNDFILE* file, float* buf, size_t count)
 {
-	WRITE_FILE(float, file, buf, count);
+	WRITE_FILE(float, file, buf, count, 1.0f);
 }
 
-sf_count_t SoundBase::write_file(SNDFILE* file, double* buf, size_t count)
+sf_count_t SoundBase::write_file(SNDFILE* file, double* buf, size_t count, double gain)
 {
-	WRITE_FILE(double, file, buf, count);
+	WRITE_FILE(double, file, buf, count, gain);
 }
 
 
@@ -597,10 +672,11 @@ size_t SoundOSS::Write(double *buf, size_t count)
 	int retval;
 	short int *wbuff;
 	unsigned char *p;
+	const float g = tx_gain;
 
 #if USE_SNDFILE
 	if (generate)
-		write_file(ofGenerate, buf, count);
+		write_file(ofGenerate, buf, count, tx_gain);
 #endif
 
 	if (txppm != progdefaults.TX_corr) {
@@ -613,7 +689,7 @@ size_t SoundOSS::Write(double *buf, size_t count)
 		wbuff = new short int[2*count];
 		p = (unsigned char *)wbuff;
 		for (size_t i = 0; i < count; i++) {
-			wbuff[2*i] = wbuff[2*i+1] = (short int)(buf[i] * maxsc);
+			wbuff[2*i] = wbuff[2*i+1] = (short int)(g * buf[i] * maxsc);
 		}
 		count *= sizeof(short int);
 		retval = write(device_fd, p, 2*count);
@@ -626,7 +702,7 @@ size_t SoundOSS::Write(double *buf, size_t count)
 		inbuf = new float[2*count];
 		size_t bufsize;
 		for (size_t i = 0; i < count; i++)
-			inbuf[2*i] = inbuf[2*i+1] = buf[i];
+			inbuf[2*i] = inbuf[2*i+1] = g * buf[i];
 		tx_src_data->data_in = inbuf;
 		tx_src_data->input_frames = count;
 		tx_src_data->data_out = src_buffer;
@@ -661,10 +737,11 @@ size_t SoundOSS::Write_stereo(double *bufleft, double *bufright, size_t count)
 	int retval;
 	short int *wbuff;
 	unsigned char *p;
+	const float g = tx_gain;
 
 #if USE_SNDFILE
 	if (generate)
-		write_file(ofGenerate, bufleft, count);
+		write_file(ofGenerate, bufleft, count, tx_gain);
 #endif
 
 	if (txppm != progdefaults.TX_corr) {
@@ -678,10 +755,10 @@ size_t SoundOSS::Write_stereo(double *bufleft, double *bufright, size_t count)
 		p = (unsigned char *)wbuff;
 		for (size_t i = 0; i < count; i++) {
 			if (progdefaults.ReverseAudio) {
-				wbuff[2*i+1] = (short int)(bufleft[i] * maxsc);
+				wbuff[2*i+1] = (short int)(g * bufleft[i] * maxsc);
 				wbuff[2*i] = (short int)(bufright[i] * maxsc);
 			} else {
-				wbuff[2*i] = (short int)(bufleft[i] * maxsc);
+				wbuff[2*i] = (short int)(g * bufleft[i] * maxsc);
 				wbuff[2*i+1] = (short int)(bufright[i] * maxsc);
 			}
 		}
@@ -697,10 +774,10 @@ size_t SoundOSS::Write_stereo(double *bufleft, double *bufright, size_t count)
 		size_t bufsize;
 		for (size_t i = 0; i < count; i++) {
 			if (progdefaults.ReverseAudio) {
-				inbuf[2*i+1] = bufleft[i];
+				inbuf[2*i+1] = g * bufleft[i];
 				inbuf[2*i] = bufright[i];
 			} else {
-				inbuf[2*i] = bufleft[i];
+				inbuf[2*i] = g * bufleft[i];
 				inbuf[2*i+1] = bufright[i];
 			}
 		}
@@ -919,6 +996,8 @@ int SoundPort::Open(int mode, int freq)
                         sd[i].state = spa_continue;
                 }
 	}
+	if (end == 1)
+		tx_route_update(sd[1].params.channelCount);
 
 	return ret;
 }
@@ -1092,25 +1171,13 @@ size_t SoundPort::Write(double *buf, size_t count)
 {
 #if USE_SNDFILE
 	if (generate)
-		write_file(ofGenerate, buf, count);
+		write_file(ofGenerate, buf, count, tx_gain);
 #endif
 
-// copy input to both channels if right channel enabled
-	for (size_t i = 0; i < count; i++)
-		if (progdefaults.mono_audio)
-			fbuf[i] = buf[i];
-		else if (progdefaults.sig_on_right_channel)
-			fbuf[sd[1].params.channelCount * i] = fbuf[sd[1].params.channelCount * i + 1] = buf[i];
-		else {
-			if (progdefaults.ReverseAudio) {
-				fbuf[sd[1].params.channelCount * i + 1] = buf[i];
-				fbuf[sd[1].params.channelCount * i] = 0;
-			} else {
-				fbuf[sd[1].params.channelCount * i] = buf[i];
-				fbuf[sd[1].params.channelCount * i + 1] = 0;
-			}
-		}
+	if (req_sample_rate == sd[1].dev_sample_rate && progdefaults.TX_corr == 0)
+		return ring_write(buf, 0, count);
 
+	tx_interleave(fbuf, buf, count);
 	return resample_write(fbuf, count);
 }
 
@@ -1121,23 +1188,57 @@ size_t SoundPort::Write_stereo(double *bufleft, double *bufright, size_t count)
 
 #if USE_SNDFILE
 	if (generate)
-		write_file(ofCapture, bufleft, count);
+		write_file(ofGenerate, bufleft, count, tx_gain);
 #endif
 
-// interleave into fbuf
-	for (size_t i = 0; i < count; i++) {
-		if (progdefaults.ReverseAudio) {
-			fbuf[sd[1].params.channelCount * i + 1] = bufleft[i];
-			fbuf[sd[1].params.channelCount * i] = bufright[i];
-		} else {
-			fbuf[sd[1].params.channelCount * i] = bufleft[i];
-			fbuf[sd[1].params.channelCount * i + 1] = bufright[i];
-		}
-	}
+	if (req_sample_rate == sd[1].dev_sample_rate && progdefaults.TX_corr == 0)
+		return ring_write(bufleft, bufright, count);
 
+	tx_interleave_stereo(fbuf, bufleft, bufright, count);
 	return resample_write(fbuf, count);
 }
 
+// Render frames straight into the output ring buffer when no resampling is
+// needed; fbuf is only used when the free space wraps around the ring.
+size_t SoundPort::ring_write(const double* left, const double* right, size_t count)
+{
+	size_t nch = sd[1].params.channelCount;
+	size_t maxframes = MIN(sd[1].rb->length() / nch / 2, SND_BUF_LEN); // don't fill the buffer
+	size_t n = 0;
+
+	while (count) {
+		size_t len = MIN(count, maxframes);
+
+		bool timeout = false;
+		WAIT_FOR_COND( (sd[1].rb->write_space() >= nch * len), sd[1].rwsem,
+			       (MAX(1.0, 2 * nch * len / sd[1].dev_sample_rate)) );
+		if (timeout)
+			throw SndException(ETIMEDOUT);
+
+		ringbuffer<float>::vector_type vec[2];
+		sd[1].rb->get_wv(vec);
+		float* wbuf = (vec[0].len >= nch * len) ? vec[0].buf : fbuf;
+
+		if (right)
+			tx_interleave_stereo(wbuf, left, right, len);
+		else
+			tx_interleave(wbuf, left, len);
+
+		if (wbuf == fbuf)
+			sd[1].rb->write(fbuf, nch * len);
+		else
+			sd[1].rb->write_advance(nch * len);
+
+		left += len;
+		if (right)
+			right += len;
+		count -= len;
+		n += len;
+	}
+
+	return n;
+}
+
 
 size_t SoundPort::resample_write(float* buf, size_t count)
 {
@@ -1674,6 +1775,7 @@ int SoundPulse::Open(int mode, int freq)
 		if (!sd[i].stream)
 			throw SndPulseException(err);
 	}
+	tx_route_update(sd[1].stream_params.channels);
 
 	return 0;
 }
@@ -1740,25 +1842,10 @@ size_t SoundPulse::Write(double* buf, size_t count)
 {
 #if USE_SNDFILE
 	if (generate)
-		write_file(ofGenerate, buf, count);
+		write_file(ofGenerate, buf, count, tx_gain);
 #endif
 
-// copy input to both channels
-	for (size_t i = 0; i < count; i++)
-		if (progdefaults.mono_audio)
-			fbuf[i] = buf[i];
-		else if (progdefaults.sig_on_right_channel)
-			fbuf[sd[1].stream_params.channels * i] = fbuf[sd[1].stream_params.channels * i + 1] = buf[i];
-		else {
-			if (progdefaults.ReverseAudio) {
-				fbuf[sd[1].stream_params.channels * i + 1] = buf[i];
-				fbuf[sd[1].stream_params.channels * i] = 0;
-			} else {
-				fbuf[sd[1].stream_params.channels * i] = buf[i];
-				fbuf[sd[1].stream_params.channels * i + 1] = 0;
-			}
-		}
-
+	tx_interleave(fbuf, buf, count);
 	return resample_write(fbuf, count);
 }
 
@@ -1769,19 +1856,10 @@ size_t SoundPulse::Write_stereo(double* bufleft, double* bufright, size_t count)
 
 #if USE_SNDFILE
 	if (generate)
-		write_file(ofGenerate, bufleft, count);
+		write_file(ofGenerate, bufleft, count, tx_gain);
 #endif
 
-	for (size_t i = 0; i < count; i++) {
-		if (progdefaults.ReverseAudio) {
-			fbuf[sd[1].stream_params.channels * i + 1] = bufleft[i];
-			fbuf[sd[1].stream_params.channels * i] = bufright[i];
-		} else {
-			fbuf[sd[1].stream_params.channels * i] = bufleft[i];
-			fbuf[sd[1].stream_params.channels * i + 1] = bufright[i];
-		}
-	}
-
+	tx_interleave_stereo(fbuf, bufleft, bufright, count);
 	return resample_write(fbuf, count);
 }
 
@@ -1905,7 +1983,7 @@ size_t SoundNull::Write(double* buf, size_t count)
 {
 #if USE_SNDFILE
 	if (generate)
-		write_file(ofGenerate, buf, count);
+		write_file(ofGenerate, buf, count, tx_gain);
 #endif
 
 	MilliSleep((long)ceil((1e3 * count) / sample_frequency));
@@ -1917,7 +1995,7 @@ size_t SoundNull::Write_stereo(double* bufleft, double* bufright, size_t count)
 {
 #if USE_SNDFILE
 	if (generate)
-		write_file(ofGenerate, bufleft, count);
+		write_file(ofGenerate, bufleft, count, tx_gain);
 #endif
 
 	MilliSleep((long)ceil((1e3 * count) / sample_frequency));
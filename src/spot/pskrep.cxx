@@ -43,12 +43,16 @@
 #include <stdint.h>
 #include <cstring>
 #include <cstdlib>
+#include <cstdio>
+#include <cstdarg>
 
 #include <string>
+#include <map>
 #include <deque>
 #include <vector>
 #include <algorithm>
 #include <fstream>
+#include <sstream>
 
 #if (__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1)
 #  define MAP_TYPE std::tr1::unordered_map
@@ -105,6 +109,15 @@ LOG_FILE_SOURCE(debug::LOG_SPOTTER);
 // Maximum send size
 #define DGRAM_MAX (1500-14-24-8)
 
+// Reports waiting to be sent are capped at MAX_PENDING; the oldest are
+// dropped first
+#define MAX_PENDING 20000
+
+// Rewrite the spool when it has SPOOL_SLACK more lines than it needs
+#define SPOOL_SLACK 4096
+
+#define PSKREP_SPOOL_FILE "pskrspool.txt"
+// the whole queue, rewritten after every report, before the spool file
 #define PSKREP_QUEUE_FILE "pskrqueue.txt"
 #define PSKREP_ID_FILE "pskrkey.txt"
 
@@ -120,24 +133,35 @@ struct rcpt_report_t
 	rcpt_report_t(trx_mode m = 0, long long f = 0, time_t t = 0,
 		      rtype_t p = PSKREP_AUTO, string loc = "")
 		: mode(m), freq(f), rtime(t), rtype(p),
-		  status(PSKR_STATUS_NEW), locator(loc) { }
+		  locator(loc), seq(0) { }
 
 	trx_mode mode;
 	long long freq;
 	time_t rtime;
 	rtype_t rtype;
 
-	status_t status;
-
 	string locator;
+	string call;
+	unsigned long seq;
+};
+
+// The reports of the last DUP_INTERVAL seconds, by callsign and band.  Only
+// the latest report is remembered: its time for the duplicate check, and its
+// sequence number so that it can be updated for as long as it is unsent.
+struct window_entry_t
+{
+	time_t rtime;
+	unsigned long seq;
 };
+typedef MAP_TYPE<string, window_entry_t> window_t;
 
-// A band_map_t holds a list of reception reports (for a particular callsign and band)
-typedef deque<rcpt_report_t> band_map_t;
-// A call_map_t holds reception reports for a particular callsign
-typedef MAP_TYPE<band_t, band_map_t, HASH_TYPE<int> > call_map_t;
-// A container of this type holds all reception reports, sorted by callsign and band
-typedef MAP_TYPE<string, call_map_t> queue_t;
+// Reports waiting to be sent, in sequence number order
+typedef deque<rcpt_report_t> pending_t;
+
+static bool seq_less(const rcpt_report_t& r, unsigned long seq)
+{
+	return r.seq < seq;
+}
 
 class pskrep_sender
 {
@@ -147,7 +171,7 @@ public:
 		      const string& long_id_, const string& short_id_);
 	~pskrep_sender();
 
-	bool append(const string& callsign, const band_map_t::value_type& r);
+	bool append(const rcpt_report_t& r);
 	bool send(void);
 
 private:
@@ -185,6 +209,16 @@ private:
 };
 
 
+// Every report goes to an append-only spool file before anything else is
+// done with it, so that a crash loses nothing:
+//
+//	R seq mode freq rtime rtype band call locator	new report
+//	L seq rtype locator				locator update
+//	S seq						reports up to seq sent
+//	W rtime band call				sent, still in the window
+//
+// The spool is replayed and compacted at start-up, and again whenever it
+// has grown SPOOL_SLACK lines past what it needs to hold.
 class pskrep
 {
 public:
@@ -205,16 +239,23 @@ private:
 
 	void append(string call, const char* loc, long long freq, trx_mode mode, time_t rtime, rtype_t rtype);
 	void gc(void);
+	void drop(size_t n);
 
-	void load_queue(void);
-	void save_queue(void);
+	static string window_key(const string& call, band_t b);
+	void replay(void);
+	void import_queue(void);
+	void compact(void);
+	void spool_line(const char* fmt, ...) format__(printf, 2, 3);
 
-	static bool not_sent(const band_map_t::value_type& r)
-	{
-		return r.status != PSKR_STATUS_SENT;
-	}
+	window_t window;
+	pending_t pending;
+	unsigned long next_seq;
+	unsigned long sent_seq;
+
+	string spool_name;
+	FILE* spool;
+	size_t spool_lines;
 
-	queue_t queue;
 	pskrep_sender sender;
 	unsigned new_count;
 };
@@ -341,15 +382,20 @@ pskrep::pskrep(const string& call, const string& loc, const string& ant,
 	       const string& host, const string& port,
 	       const string& long_id, const string& short_id,
 	       bool reg_auto, bool reg_log, bool reg_manual)
-	: sender(call, loc, ant, host, port, long_id, short_id), new_count(0)
+	: next_seq(1), sent_seq(0), spool(0), spool_lines(0),
+	  sender(call, loc, ant, host, port, long_id, short_id), new_count(0)
 {
+	spool_name = TempDir;
+	spool_name.append(PSKREP_SPOOL_FILE);
+	replay();
+	import_queue();
+
 	if (reg_auto)
 		spot_register_recv(pskrep::recv, this, PSKREP_RE, REG_EXTENDED | REG_ICASE);
 	if (reg_log)
 		spot_register_log(pskrep::log, this);
 	if (reg_manual)
 		spot_register_manual(pskrep::manual, this);
-	load_queue();
 }
 
 pskrep::~pskrep()
@@ -357,7 +403,8 @@ pskrep::~pskrep()
 	spot_unregister_recv(pskrep::recv, this);
 	spot_unregister_log(pskrep::log, this);
 	spot_unregister_manual(pskrep::manual, this);
-	save_queue();
+	if (spool)
+		fclose(spool);
 }
 
 // This function is called by spot_recv() when its buffer matches our PSKREP_RE
@@ -389,11 +436,21 @@ void pskrep::manual(const char* call, const char* loc, long long freq, trx_mode
 	reinterpret_cast<pskrep*>(obj)->append(call, loc, freq, mode, rtime, PSKREP_MANUAL);
 }
 
+string pskrep::window_key(const string& call, band_t b)
+{
+	string key;
+	key.reserve(call.length() + 2);
+	return key.assign(call).append(1, '\0').append(1, static_cast<char>(b));
+}
+
 void pskrep::append(string call, const char* loc, long long freq, trx_mode mode, time_t rtime, rtype_t rtype)
 {
 	if (unlikely(call.empty()))
 		return;
 	transform(call.begin(), call.end(), call.begin(), static_cast<int (*)(int)>(toupper));
+	// the spool is whitespace separated
+	if (call.find_first_of(" \t\r\n") != string::npos)
+		return;
 
 	if (!progdefaults.pskrep_qrg)
 		freq = 0LL;
@@ -401,95 +458,82 @@ void pskrep::append(string call, const char* loc, long long freq, trx_mode mode,
 	if (*loc && !locator_re.match(loc))
 		loc = "";
 
-	band_map_t& bandq = queue[call][band(freq)];
-	if (bandq.empty() || rtime - bandq.back().rtime >= DUP_INTERVAL) { // add new
-		bandq.push_back(rcpt_report_t(mode, freq, rtime, rtype, loc));
+	band_t b = band(freq);
+	pair<window_t::iterator, bool> w = window.insert(make_pair(window_key(call, b), window_entry_t()));
+	window_entry_t& e = w.first->second;
+	if (w.second || rtime - e.rtime >= DUP_INTERVAL) { // add new
+		if (pending.size() == MAX_PENDING)
+			drop(1);
+		pending.push_back(rcpt_report_t(mode, freq, rtime, rtype, loc));
+		rcpt_report_t& r = pending.back();
+		r.call = call;
+		r.seq = next_seq++;
+		e.rtime = rtime;
+		e.seq = r.seq;
+		spool_line("R %lu %d %lld %jd %d %d %s %s\n", r.seq, (int)r.mode, r.freq, (intmax_t)r.rtime,
+			   r.rtype, b, r.call.c_str(), r.locator.empty() ? "?" : r.locator.c_str());
 		LOG_VERBOSE("Added (call=\"%s\", loc=\"%s\", mode=\"%s\", freq=%lld, time=%jd, type=%u)",
 			 call.c_str(), loc, mode_info[mode].adif_name, freq, (intmax_t)rtime, rtype);
 		new_count++;
-		save_queue();
 	}
-	else if (!bandq.empty()) {
-		band_map_t::value_type& r = bandq.back();
-		if (r.status != PSKR_STATUS_SENT && *loc && r.locator != loc) { // update last
+	else if (e.seq > sent_seq && *loc) {
+		pending_t::iterator i = lower_bound(pending.begin(), pending.end(), e.seq, seq_less);
+		if (i == pending.end() || i->seq != e.seq)
+			return;
+		rcpt_report_t& r = *i;
+		if (r.locator != loc) { // update last
 			r.locator = loc;
 			r.rtype = rtype;
+			spool_line("L %lu %d %s\n", r.seq, r.rtype, loc);
 			LOG_VERBOSE("Updated (call=\"%s\", loc=\"%s\", mode=\"%s\", freq=%lld, time=%jd, type=%u)",
 				 call.c_str(), loc, mode_info[r.mode].adif_name, r.freq, (intmax_t)r.rtime, rtype);
-			save_queue();
 		}
 	}
 }
 
-// Handle queued reports
+// Handle queued reports: fill and send datagrams straight from the front of
+// the pending queue until it is empty
 bool pskrep::progress(void)
 {
-	if (queue.empty())
-		return true;
+	unsigned nrep = 0, ndgram = 0;
 
-	unsigned nrep = 0;
-	bool sender_full = false;
-	for (queue_t::iterator i = queue.begin(); i != queue.end(); ++i) {
-		for (call_map_t::iterator j = i->second.begin(); j != i->second.end(); ++j) {
-			for (band_map_t::iterator k = j->second.begin(); k != j->second.end(); ++k) {
-				switch (k->status) {
-				case PSKR_STATUS_NEW:
-					if ((sender_full = !sender.append(i->first, *k)))
-						goto send_reports;
-					k->status = PSKR_STATUS_PENDING;
-					nrep++;
-					break;
-				case PSKR_STATUS_PENDING: // sent in last cycle
-					k->status = PSKR_STATUS_SENT;
-				default:
-					break;
-				}
-			}
+	while (!pending.empty()) {
+		size_t n = 0;
+		while (n < pending.size() && sender.append(pending[n]))
+			n++;
+		if (n == 0) { // cannot happen with MAX_TEXT_SIZE fields
+			drop(1);
+			continue;
 		}
-	}
-
-send_reports:
-	LOG_VERBOSE("Found %u new report(s)", nrep);
-	if (nrep) {
 		if (!sender.send()) {
 			LOG_ERROR("Sender failed, disabling pskreporter");
 			return false;
 		}
-		return progress();
+		sent_seq = pending[n - 1].seq;
+		pending.erase(pending.begin(), pending.begin() + n);
+		spool_line("S %lu\n", sent_seq);
+		nrep += n;
+		ndgram++;
 	}
+	LOG_VERBOSE("Sent %u report(s) in %u datagram(s)", nrep, ndgram);
 
 	gc();
-	save_queue();
+	if (spool_lines > pending.size() + window.size() + SPOOL_SLACK)
+		compact();
 	return true;
 }
 
-// Delete sent reports that are older than DUP_INTERVAL seconds
+// Forget sent reports that are older than DUP_INTERVAL seconds
 void pskrep::gc(void)
 {
 	time_t threshold = time(NULL) - DUP_INTERVAL;
 	unsigned rm = 0;
 
-	for (queue_t::iterator i = queue.begin(); i != queue.end() ; ) {
-		for (call_map_t::iterator j = i->second.begin(); j != i->second.end() ; ) {
-			band_map_t& b = j->second;
-			band_map_t::iterator k = find_if(b.begin(), b.end(), not_sent);
-			if (k != b.begin() && k == b.end())
-				--k;
-			rm += k - b.begin();
-			k = b.erase(b.begin(), k);
-
-			if (k != b.end() && k->status == PSKR_STATUS_SENT && k->rtime <= threshold) {
-				b.erase(k);
-				rm++;
-			}
-
-			if (b.empty())
-				i->second.erase(j++);
-			else
-				++j;
+	for (window_t::iterator i = window.begin(); i != window.end(); ) {
+		if (i->second.seq <= sent_seq && i->second.rtime <= threshold) {
+			window.erase(i++);
+			rm++;
 		}
-		if (i->second.empty())
-			queue.erase(i++);
 		else
 			++i;
 	}
@@ -497,24 +541,158 @@ void pskrep::gc(void)
 	LOG_DEBUG("Removed %u sent report(s)", rm);
 }
 
-static ostream& operator<<(ostream& out, const rcpt_report_t& r);
-static istream& operator>>(istream& in, rcpt_report_t& r);
-static ostream& operator<<(ostream& out, const queue_t& q);
-static istream& operator>>(istream& in, queue_t& q);
+// Give up on the n oldest unsent reports
+void pskrep::drop(size_t n)
+{
+	n = MIN(n, pending.size());
+	if (!n)
+		return;
+	LOG_WARN("Report queue full, dropping %" PRIuSZ " report(s)", n);
+	sent_seq = pending[n - 1].seq;
+	pending.erase(pending.begin(), pending.begin() + n);
+	spool_line("S %lu\n", sent_seq);
+}
 
-void pskrep::save_queue(void)
+void pskrep::spool_line(const char* fmt, ...)
 {
-	string fname = TempDir;
-	fname.append(PSKREP_QUEUE_FILE);
-	ofstream out(fname.c_str());
+	if (!spool)
+		return;
+
+	va_list ap;
+	va_start(ap, fmt);
+	int r = vfprintf(spool, fmt, ap);
+	va_end(ap);
+
+	if (r < 0 || fflush(spool) != 0) {
+		LOG_ERROR("Could not write %s", spool_name.c_str());
+		fclose(spool);
+		spool = 0;
+		return;
+	}
+	spool_lines++;
+}
+
+// Called from the constructor: rebuild the pending queue and the window from
+// the spool, then compact it
+void pskrep::replay(void)
+{
+	ifstream in(spool_name.c_str());
+	map<unsigned long, pair<rcpt_report_t, int> > reports;
+	time_t threshold = time(NULL) - DUP_INTERVAL;
+	string line;
+
+	while (in && getline(in, line)) {
+		istringstream is(line);
+		char type = 0;
+		unsigned long seq = 0;
+		rcpt_report_t r;
+		int rtype, band;
+		intmax_t rtime;
+		string s;
+
+		// a crash may have left a partial last line
+		is >> type;
+		switch (type) {
+		case 'R':
+			if (!(is >> seq >> r.mode >> r.freq >> rtime >> rtype >> band >> r.call >> r.locator))
+				continue;
+			if (r.locator == "?")
+				r.locator.clear();
+			r.rtime = rtime;
+			r.rtype = static_cast<rtype_t>(rtype);
+			r.seq = seq;
+			reports[seq] = make_pair(r, band);
+			break;
+		case 'L':
+			if (!(is >> seq >> rtype >> s) || reports.find(seq) == reports.end())
+				continue;
+			reports[seq].first.rtype = static_cast<rtype_t>(rtype);
+			reports[seq].first.locator = s;
+			break;
+		case 'S':
+			if (is >> seq)
+				sent_seq = MAX(sent_seq, seq);
+			break;
+		case 'W':
+			if (!(is >> rtime >> band >> s) || rtime <= threshold)
+				continue;
+			// seq 0: sent before the spool was last compacted
+			window[window_key(s, static_cast<band_t>(band))].rtime = rtime;
+			break;
+		}
+		next_seq = MAX(next_seq, seq + 1);
+	}
+	in.close();
+
+	next_seq = MAX(next_seq, sent_seq + 1);
+	for (map<unsigned long, pair<rcpt_report_t, int> >::iterator i = reports.begin(); i != reports.end(); ++i) {
+		const rcpt_report_t& r = i->second.first;
+		if (r.seq <= sent_seq && r.rtime <= threshold)
+			continue;
+		window_entry_t& e = window[window_key(r.call, static_cast<band_t>(i->second.second))];
+		e.rtime = r.rtime;
+		e.seq = r.seq;
+		if (r.seq > sent_seq)
+			pending.push_back(r);
+	}
+	if (pending.size())
+		LOG_INFO("%" PRIuSZ " report(s) left to send from last session", pending.size());
+	if (pending.size() > MAX_PENDING)
+		drop(pending.size() - MAX_PENDING);
+
+	compact();
+}
 
+// Rewrite the spool with only what is still needed, then append to it
+void pskrep::compact(void)
+{
+	if (spool) {
+		fclose(spool);
+		spool = 0;
+	}
+
+	string temp = spool_name + ".tmp";
+	FILE* out = fopen(temp.c_str(), "w");
+	size_t n = 0;
+	bool success = out;
+
+	for (window_t::const_iterator i = window.begin(); success && i != window.end(); ++i) {
+		if (i->second.seq > sent_seq)
+			continue;
+		const string& key = i->first;
+		string::size_type z = key.find('\0');
+		success = fprintf(out, "W %jd %d %s\n", (intmax_t)i->second.rtime,
+				  static_cast<unsigned char>(key[z + 1]), key.substr(0, z).c_str()) > 0;
+		n++;
+	}
+	if (success && sent_seq)
+		success = fprintf(out, "S %lu\n", sent_seq) > 0;
+	for (pending_t::const_iterator r = pending.begin(); success && r != pending.end(); ++r) {
+		success = fprintf(out, "R %lu %d %lld %jd %d %d %s %s\n", r->seq, (int)r->mode, r->freq,
+				  (intmax_t)r->rtime, r->rtype, band(r->freq), r->call.c_str(),
+				  r->locator.empty() ? "?" : r->locator.c_str()) > 0;
+		n++;
+	}
 	if (out)
-		out << queue;
-	else
-		LOG_ERROR("Could not write %s", fname.c_str());
+		success = fclose(out) == 0 && success;
+#ifdef __WOE32__
+	if (success)
+		remove(spool_name.c_str());
+#endif
+
+	if (success && rename(temp.c_str(), spool_name.c_str()) == 0)
+		spool_lines = n;
+	else {
+		LOG_ERROR("Could not rewrite %s", spool_name.c_str());
+		remove(temp.c_str());
+	}
+
+	if ((spool = fopen(spool_name.c_str(), "a")) == NULL)
+		LOG_ERROR("Could not open %s, reports will not survive a restart", spool_name.c_str());
 }
 
-void pskrep::load_queue(void)
+// Queue the unsent reports from the old whole-queue file, then remove it
+void pskrep::import_queue(void)
 {
 	string fname = TempDir;
 	fname.append(PSKREP_QUEUE_FILE);
@@ -522,13 +700,17 @@ void pskrep::load_queue(void)
 	if (!in)
 		return;
 
-	in >> queue;
-	// restore pending reports as new
-	for (queue_t::iterator i = queue.begin(); i != queue.end(); ++i)
-		for (call_map_t::iterator j = i->second.begin(); j != i->second.end(); ++j)
-			for (band_map_t::iterator k = j->second.begin(); k != j->second.end(); ++k)
-				if (k->status == PSKR_STATUS_PENDING)
-					k->status = PSKR_STATUS_NEW;
+	rcpt_report_t r;
+	int rtype, status, b;
+	string loc;
+	while (in >> r.mode >> r.freq >> r.rtime >> rtype >> status >> loc >> b >> r.call) {
+		if (status == PSKR_STATUS_SENT)
+			continue;
+		append(r.call, loc == "?" ? "" : loc.c_str(), r.freq, r.mode, r.rtime,
+		       static_cast<rtype_t>(rtype));
+	}
+	in.close();
+	remove(fname.c_str());
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -711,8 +893,9 @@ void pskrep_sender::write_preamble(void)
 	dgram_size = p - dgram;
 }
 
-bool pskrep_sender::append(const string& callsign, const band_map_t::value_type& r)
+bool pskrep_sender::append(const rcpt_report_t& r)
 {
+	const string& callsign = r.call;
 	if (dgram_size == 0)
 		write_preamble();
 
@@ -728,7 +911,8 @@ bool pskrep_sender::append(const string& callsign, const band_map_t::value_type&
 	// call_len + call + time + freq + mode_len + mode + loc_len + loc + info
 	size_t rlen = 1 + call_len + 4 + 4 + 1 + mode_len + 1 + loc_len + 1;
 
-	if (pad(rlen, PAD) + dgram_size > DGRAM_MAX) // datagram full
+	// datagram full, counting the padding that send() adds to the record set
+	if (report_offset + pad(dgram_size + rlen - report_offset, PAD) > DGRAM_MAX)
 		return false;
 
 
@@ -827,52 +1011,3 @@ size_t pskrep_sender::pad(size_t len, size_t mult)
 	size_t r = len % mult;
 	return r ? len + mult - r : len;
 }
-
-// -------------------------------------------------------------------------------------------------
-
-static istream& operator>>(istream& in, rtype_t& t)
-{
-	int i;
-	in >> i;
-	t = static_cast<rtype_t>(i);
-	return in;
-}
-static istream& operator>>(istream& in, status_t& t)
-{
-	int i;
-	in >> i;
-	t = static_cast<status_t>(i);
-	return in;
-}
-static istream& operator>>(istream& in, rcpt_report_t& r)
-{
-	in >> r.mode >> r.freq  >> r.rtime >> r.rtype >> r.status >> r.locator;
-	if (*r.locator.c_str() == '?') r.locator.clear();
-	return in;
-}
-
-static ostream& operator<<(ostream& out, const rcpt_report_t& r)
-{
-	return out << r.mode << ' ' << r.freq << ' ' << r.rtime << ' '
-		   << r.rtype << ' ' << r.status << ' ' << (r.locator.empty() ? "?" : r.locator);
-}
-static ostream& operator<<(ostream& out, const queue_t& q)
-{
-	for (queue_t::const_iterator i = q.begin(); i != q.end(); ++i)
-		for (call_map_t::const_iterator j = i->second.begin(); j != i->second.end(); ++j)
-			for (band_map_t::const_iterator k = j->second.begin(); k != j->second.end(); ++k)
-				out << *k << "  " << j->first << "  " << i->first << '\n';
-
-	return out;
-}
-static istream& operator>>(istream& in, queue_t& q)
-{
-	rcpt_report_t rep;
-	int band;
-	string call;
-
-	while (in >> rep >> band >> call)
-	 	q[call][static_cast<band_t>(band)].push_back(rep);
-
-	return in;
-}
@@ -5,8 +5,6 @@
 #include <setjmp.h>
 #include "ssdv_rx.h"
 
-#include <curl/curl.h>
-
 /* For put_status() */
 #include "fl_digi.h"
 
@@ -16,11 +14,8 @@
 /* For online() getter */
 #include "dl_fldigi/dl_fldigi.h"
 
-/* Used for passing curl data to post thread */
-typedef struct {
-	CURL *curl;
-	struct curl_httppost* post;
-} ssdv_post_data_t;
+/* For the upload spool */
+#include "dl_fldigi/hbtint.h"
 
 #if 1
 
@@ -266,120 +261,26 @@ void ssdv_rx::clear_buffer()
 	bl = 0;
 }
 
-static void *upload_packet_thread(void *arg)
-{
-	ssdv_post_data_t *t = (ssdv_post_data_t *) arg;
-	struct curl_httppost* post = t->post;
-	CURL *curl = t->curl;
-	CURLcode r;
-	
-	r = curl_easy_perform(curl);
-	if(r == 0)
-	{
-		fprintf(stderr, "SSDV: packet uploaded!\n");
-	}
-	else
-	{
-		fprintf(stderr, "CURL upload failed! \"%s\"\n", curl_easy_strerror(r));
-	}
-	
-	curl_easy_cleanup(curl);
-	curl_formfree(post);
-	
-	free(t);
-	
-	pthread_exit(0);
-}
-
 /* TODO: HABITAT-LATER upload using habitat */
 void ssdv_rx::upload_packet(int fixes)
 {
-	ssdv_post_data_t *t;
-	pthread_attr_t attr;
-	pthread_t thread;
 	const char *callsign;
-	char *packet;
-	char data[10];
-	struct curl_httppost* post = NULL;
-	struct curl_httppost* last = NULL;
-	CURL *curl;
+	char packet[SSDV_PKT_SIZE * 2 + 1];
 	
 	/* Don't upload if no URL is present */
 	if(progdefaults.ssdv_packet_url.length() <= 0) return;
 	
 	/* Get the callsign, or "UNKNOWN" if none is set */
 	callsign = (progdefaults.myCall.empty() ? "UNKNOWN" : progdefaults.myCall.c_str());
-	curl_formadd(&post, &last, CURLFORM_COPYNAME, "callsign",
-		CURLFORM_COPYCONTENTS, callsign, CURLFORM_END);
-	
-	/* The encoding used on the packet */
-	curl_formadd(&post, &last, CURLFORM_COPYNAME, "encoding",
-		CURLFORM_COPYCONTENTS, "hex", CURLFORM_END);
-	
-	/* Include the number of bytes corrected by the FEC */
-	snprintf(data, 10, "%i", fixes);
-	curl_formadd(&post, &last, CURLFORM_COPYNAME, "fixes",
-		CURLFORM_COPYCONTENTS, data, CURLFORM_END);
-	
-	/* URL-encode the packet */
-	packet = (char *) malloc((SSDV_PKT_SIZE * 2) + 1);
-	if(!packet)
-	{
-		fprintf(stderr, "ssdv_rx::upload_packet(): failed to allocate memory for packet\n");
-		curl_formfree(post);
-		return;
-	}
 	
+	/* Hex-encode the packet */
 	for(int i = 0; i < SSDV_PKT_SIZE; i++)
 		snprintf(packet + (i * 2), 3, "%02X", buffer[bc + i]);
 	
-	/* Add a copy of the packet */
-	curl_formadd(&post, &last, CURLFORM_COPYNAME, "packet",
-		CURLFORM_COPYCONTENTS, packet, CURLFORM_END);
-	
-	free(packet);
-	
-	/* Initialise libcurl */
-	curl = curl_easy_init();
-	if(!curl)
-	{
-		fprintf(stderr, "ssdv_rx::upload_packet(): curl_easy_init() failed\n");
-		curl_formfree(post);
-		return;
-	}
-	
-	curl_easy_setopt(curl, CURLOPT_URL, progdefaults.ssdv_packet_url.c_str());
-	curl_easy_setopt(curl, CURLOPT_HTTPPOST, post); 
-	
-	/* Begin the thread to do the post */
-	t = (ssdv_post_data_t *) malloc(sizeof(ssdv_post_data_t));
-	if(!t)
-	{
-		fprintf(stderr, "ssdv_rx::upload_packet(): failed to allocate memory for thread data\n");
-		curl_easy_cleanup(curl);
-		curl_formfree(post);
-		return;
-	}
-	
-	t->curl = curl;
-	t->post = post;
-	
-	pthread_attr_init(&attr);
-	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-	
-	if(pthread_create(&thread, &attr, upload_packet_thread, (void *) t) != 0)
-	{
-		fprintf(stderr, "ssdv_rx::upload_packet(): failed to start post thread\n");
-		curl_easy_cleanup(curl);
-		curl_formfree(post);
-		free(t);
-	}
-	
-	pthread_attr_destroy(&attr);
-	
-	/* All done! */
-	
-	return;
+	/* The upload spool posts it, and keeps it until the server has it */
+	if(dl_fldigi::hbtint::sthr)
+		dl_fldigi::hbtint::sthr->ssdv_packet(progdefaults.ssdv_packet_url,
+			callsign, packet, fixes);
 }
 
 void ssdv_rx::put_byte(uint8_t byte, int lost)
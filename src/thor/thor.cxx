@@ -526,18 +526,19 @@ int thor::rx_process(const double *buf, int len)
 
 	if (filter_reset) reset_filters();
 
-	if (slowcpu != progdefaults.slowcpu) {
-		slowcpu = progdefaults.slowcpu;
+	if (rx_params_changed() && slowcpu != rxp.slowcpu) {
+		slowcpu = rxp.slowcpu;
 		reset_filters();
 	}
 	
+	const bool use_filter = rxp.THOR_FILTER;
 	while (len) {
 // create analytic signal at first IF
 		zref.re = zref.im = *buf++;
 		hilbert->run(zref, zref);
 		zref = mixer(0, zref);
 
-		if (progdefaults.THOR_FILTER) {
+		if (use_filter) {
 // filter using fft convolution
 			n = fft->run(zref, &zp);
 		} else {
@@ -596,18 +597,11 @@ int thor::get_secondary_char()
 
 void thor::sendtone(int tone, int duration)
 {
-	double f, phaseincr;
-	f = (tone + 0.5) * tonespacing + get_txfreq_woffset() - bandwidth / 2;
-	phaseincr = TWOPI * f / samplerate;
+	double f0 = 0.5 * tonespacing + get_txfreq_woffset() - bandwidth / 2;
+	if (!txtones.matches(THORNUMTONES, f0, tonespacing, symlen, samplerate))
+		txtones.build(THORNUMTONES, f0, tonespacing, symlen, samplerate);
 	for (int j = 0; j < duration; j++) {
-		for (int i = 0; i < symlen; i++) {
-			outbuf[i] = cos(txphase);
-			txphase -= phaseincr;
-			if (txphase > M_PI)
-				txphase -= TWOPI;
-			else if (txphase < M_PI)
-				txphase += TWOPI;
-		}
+		txtones.render(outbuf, tone, txphase);
 		ModulateXmtr(outbuf, symlen);
 	}
 }
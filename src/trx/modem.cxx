@@ -23,6 +23,7 @@
 #include <config.h>
 
 #include <string>
+#include <cstring>
 
 #include "misc.h"
 #include "filters.h"
@@ -132,11 +133,44 @@ modem::modem()
 	reverse = wfrev ^ !wfsb;
 	historyON = false;
 	cap = CAP_RX | CAP_TX;
-	PTTphaseacc = 0.0;
+	PTTosc.reset();
 	frequency = 1000.0;
 	s2n_ncount = s2n_sum = s2n_sum2 = s2n_metric = 0.0;
 	s2n_valid = false;
 	track_freq_lock = 0;
+	memset(&rxp, 0, sizeof(rxp));
+	rx_params_take(rxp);
+	rxp_applied = 0;
+}
+
+// Refresh p from progdefaults, bumping its version if anything changed
+bool rx_params_take(rx_params& p)
+{
+	if (p.version &&
+	    p.slowcpu == progdefaults.slowcpu &&
+	    p.RTTY_BW == progdefaults.RTTY_BW &&
+	    p.oliviatones == progdefaults.oliviatones &&
+	    p.oliviabw == progdefaults.oliviabw &&
+	    p.oliviasmargin == progdefaults.oliviasmargin &&
+	    p.oliviasinteg == progdefaults.oliviasinteg &&
+	    p.THOR_FILTER == progdefaults.THOR_FILTER &&
+	    p.mt63_interleave == progdefaults.mt63_interleave &&
+	    p.mt63_rx_integration == progdefaults.mt63_rx_integration &&
+	    p.mt63_8bit == progdefaults.mt63_8bit)
+		return false;
+
+	p.slowcpu = progdefaults.slowcpu;
+	p.RTTY_BW = progdefaults.RTTY_BW;
+	p.oliviatones = progdefaults.oliviatones;
+	p.oliviabw = progdefaults.oliviabw;
+	p.oliviasmargin = progdefaults.oliviasmargin;
+	p.oliviasinteg = progdefaults.oliviasinteg;
+	p.THOR_FILTER = progdefaults.THOR_FILTER;
+	p.mt63_interleave = progdefaults.mt63_interleave;
+	p.mt63_rx_integration = progdefaults.mt63_rx_integration;
+	p.mt63_8bit = progdefaults.mt63_8bit;
+	p.version++;
+	return true;
 }
 
 // modem types CW and RTTY do not use the base init()
@@ -278,14 +312,6 @@ void modem::set_samplerate(int smprate)
 	samplerate = smprate;
 }
 
-double modem::PTTnco()
-{
-	PTTphaseacc += TWOPI * 1000 / samplerate;
-	if (PTTphaseacc > M_PI)
-		PTTphaseacc -= TWOPI;
-	return sin(PTTphaseacc);
-}
-
 double modem::sigmaN (double es_ovr_n0)
 {
 	double sn_ratio, sigma;
@@ -375,9 +401,9 @@ void modem::s2nreport(void)
 void modem::ModulateXmtr(double *buffer, int len)
 {
     if (progdefaults.PTTrightchannel) {
-        for (int i = 0; i < len; i++)
-            PTTchannel[i] = PTTnco();
-            ModulateStereo( buffer, PTTchannel, len);
+        PTTosc.set_freq(1000, samplerate);
+        PTTosc.fill_sin(PTTchannel, len);
+        ModulateStereo( buffer, PTTchannel, len);
         return;
     }
 
@@ -386,8 +412,8 @@ void modem::ModulateXmtr(double *buffer, int len)
 
 	if (withnoise && progdefaults.noise) add_noise(buffer, len);
 
-	double mult = pow(10, progdefaults.txlevel / 20.0);
-	for (int i = 0; i < len; i++) buffer[i] *= mult;
+	// the sound card applies the level while converting to its format
+	scard->set_txlevel(progdefaults.txlevel);
 
 	try {
 		unsigned n = 4;
@@ -411,8 +437,7 @@ void modem::ModulateStereo(double *left, double *right, int len)
 
 	if (withnoise && progdefaults.noise) add_noise(left, len);
 
-	double mult = pow(10, progdefaults.txlevel / 20.0);
-	for (int i = 0; i < len; i++) left[i] *= mult;
+	scard->set_txlevel(progdefaults.txlevel);
 
 	try {
 		unsigned n = 4;
@@ -494,16 +519,6 @@ void modem::cwid_makeshape()
 		cwid_keyshape[i] = 0.5 * (1.0 - cos (M_PI * i / RT));
 }
 
-double modem::cwid_nco(double freq)
-{
-	cwid_phaseacc += 2.0 * M_PI * freq / samplerate;
-
-	if (cwid_phaseacc > M_PI)
-		cwid_phaseacc -= 2.0 * M_PI;
-
-	return sin(cwid_phaseacc);
-}
-
 //=====================================================================
 // cwid_send_symbol()
 // Sends a part of a morse character (one dot duration) of either
@@ -525,26 +540,25 @@ void modem::cwid_send_symbol(int bits)
 	freq = tx_frequency - progdefaults.TxOffset;
 
     if ((currsym == 1) && (cwid_lastsym == 0))
-    	cwid_phaseacc = 0.0;
+    	cwid_osc.reset();
+	cwid_osc.set_freq(freq, samplerate);
 
 	keydown = cwid_symbollen - RT;
 	keyup = cwid_symbollen - RT;
 
 	if (currsym == 1) {
-		for (i = 0; i < RT; i++, sample++) {
-			if (cwid_lastsym == 0)
-				outbuf[sample] = cwid_nco(freq) * cwid_keyshape[i];
-			else
-				outbuf[sample] = cwid_nco(freq);
-		}
-		for (i = 0; i < keydown; i++, sample++) {
-			outbuf[sample] = cwid_nco(freq);
-		}
+		if (cwid_lastsym == 0)
+			cwid_osc.fill_sin(outbuf, RT, cwid_keyshape);
+		else
+			cwid_osc.fill_sin(outbuf, RT);
+		sample += RT;
+		cwid_osc.fill_sin(outbuf + sample, keydown);
+		sample += keydown;
 	}
 	else {
 		for (i = RT - 1; i >= 0; i--, sample++) {
 			if (cwid_lastsym == 1) {
-				outbuf[sample] = cwid_nco(freq) * cwid_keyshape[i];
+				outbuf[sample] = cwid_osc.next_sin() * cwid_keyshape[i];
 			} else {
 				outbuf[sample] = 0.0;
 			}
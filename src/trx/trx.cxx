@@ -41,6 +41,8 @@
 
 #include "soundconf.h"
 #include "ringbuffer.h"
+#include "audiobus.h"
+#include "timeops.h"
 #include "qrunner.h"
 #include "debug.h"
 
@@ -73,11 +75,18 @@ cDTMF		*dtmf = 0;
 SoundBase 	*scard;
 static int	_trx_tune;
 
-// Ringbuffer for the audio "history". A pointer into this buffer
-// is also passed to the waterfall signal drawing routines.
+// Ringbuffer for the transmitted audio drawn by the waterfall
 #define NUMMEMBUFS 1024
 static ringbuffer<double> trxrb(ceil2(NUMMEMBUFS * SCBLOCKSIZE));
+// Received audio blocks.  The bus also holds the audio "history" and is
+// read by the waterfall from the GUI thread.
+#define RXBUS_SPARES 16
+static audio_bus<double> rxbus(NUMMEMBUFS, RXBUS_SPARES, SCBLOCKSIZE);
+// used when every block of rxbus is held by a consumer
+static double rxbuf[SCBLOCKSIZE];
 static float fbuf[SCBLOCKSIZE];
+// Modem configuration, refreshed once per received block
+static rx_params trx_rxp;
 bool    bHistory = false;
 
 static bool trxrunning = false;
@@ -123,6 +132,36 @@ static void trx_xmit_wfall_draw(int samplerate)
 	}
 }
 
+// Insert a line in the RX pane telling where the replayed audio begins.
+// `age' is the number of seconds of audio that will be replayed.  It only
+// goes to the pane: put_rx_char would also hand it to the ARQ client, the
+// spotter, the logs etc.
+static void trx_history_mark(double age)
+{
+	char msg[64];
+	time_t t = time(NULL) - (time_t)age;
+	struct tm tm;
+
+	gmtime_r(&t, &tm);
+	size_t n = strftime(msg, sizeof(msg), "\n<< history from %H:%M:%SZ >>\n", &tm);
+	if (n)
+		REQ(&FTextRX::addstr, ReceiveText, string(msg, n), FTextBase::CTRL);
+}
+
+// Draws all received blocks published since the last call
+static void trx_rx_wfall_draw(void)
+{
+	ENSURE_THREAD(FLMAIN_TID);
+
+	static audio_bus<double>::reader wfreader(rxbus);
+	audio_bus<double>::block* b;
+
+	while ((b = wfreader.get())) {
+		wf->sig_data(b->data, b->len, b->samplerate);
+		wfreader.release(b);
+	}
+}
+
 // Called by trx_trx_transmit_loop() to handle data that may be left in the
 // ringbuffer when we stop transmitting. Will pad with zeroes to a multiple of
 // WFBLOCKSIZE.
@@ -185,6 +224,14 @@ void trx_xmit_wfall_queue(int samplerate, const double* buf, size_t len)
 
 //=============================================================================
 
+// Leave history replay, giving back the AFC setting saved when it began
+static void trx_history_end(bool afc)
+{
+	progStatus.afconoff = afc;
+	bHistory = false;
+	active_modem->HistoryON(false);
+}
+
 void trx_trx_receive_loop()
 {
 	size_t  numread;
@@ -225,54 +272,106 @@ void trx_trx_receive_loop()
 	}
 	active_modem->rx_init();
 
-	ringbuffer<double>::vector_type rbvec[2];
-	rbvec[0].buf = rbvec[1].buf = 0;
+	audio_bus<double>::block* blk;
+	double* dbuf;
+
+	// The modem reads the bus through its own reader.  It normally
+	// follows the live audio; a history request rewinds it to the oldest
+	// block and the modem then catches up a few blocks at a time, while
+	// live audio keeps being read and queued on the bus, so nothing is
+	// lost while the history is decoded.
+	audio_bus<double>::reader modem_reader(rxbus);
+	bool replaying = false, afc = progStatus.afconoff;
+	struct timespec t0, t1, replay_end;
 
 	while (1) {
+		blk = rxbus.claim();
+		dbuf = blk ? blk->data : rxbuf;
 		try {
 			numread = 0;
 			while (numread < SCBLOCKSIZE && trx_state == STATE_RX)
 				numread += scard->Read(fbuf + numread, SCBLOCKSIZE - numread);
-			if (trxrb.write_space() == 0) // discard some old data
-				trxrb.read_advance(SCBLOCKSIZE);
-			trxrb.get_wv(rbvec);
-			// convert to double and write to rb
+			// convert to double
 			for (size_t i = 0; i < numread; i++)
-				rbvec[0].buf[i] = fbuf[i];
+				dbuf[i] = fbuf[i];
 		}
 		catch (const SndException& e) {
+			if (blk)
+				rxbus.release(blk);
+			if (replaying)
+				trx_history_end(afc);
 			scard->Close();
 			LOG_ERROR("%s", e.what());
 			put_status(e.what(), 5);
 			MilliSleep(10);
 			return;
 		}
-		if (trx_state != STATE_RX)
+		if (trx_state != STATE_RX) {
+			if (blk)
+				rxbus.release(blk);
+			if (replaying)
+				trx_history_end(afc);
 			break;
+		}
 
-		trxrb.write_advance(numread);
-		REQ(&waterfall::sig_data, wf, rbvec[0].buf, numread, current_samplerate);
-
-		if (!bHistory) {
-			active_modem->rx_process(rbvec[0].buf, numread);
-			if (progdefaults.rsid)
-				ReedSolomon->receive(fbuf, numread);
-			dtmf->receive(fbuf, numread);
+		if (blk) {
+			blk->len = numread;
+			blk->samplerate = current_samplerate;
+			rxbus.publish(blk);
+			REQ(trx_rx_wfall_draw);
 		}
-		else {
-			bool afc = progStatus.afconoff;
+
+		rx_params_take(trx_rxp);
+		active_modem->set_rx_params(trx_rxp);
+
+		if (progdefaults.rsid)
+			ReedSolomon->receive(fbuf, numread);
+		dtmf->receive(fbuf, numread);
+
+		if (bHistory && !replaying) {
+			replaying = true;
+			afc = progStatus.afconoff;
 			progStatus.afconoff = false;
-			QRUNNER_DROP(true);
 			active_modem->HistoryON(true);
-			trxrb.get_rv(rbvec);
-			if (rbvec[0].len)
-				active_modem->rx_process(rbvec[0].buf, rbvec[0].len);
-			if (rbvec[1].len)
-				active_modem->rx_process(rbvec[1].buf, rbvec[1].len);
-			QRUNNER_DROP(false);
-			progStatus.afconoff = afc;
-			bHistory = false;
-			active_modem->HistoryON(false);
+			modem_reader.rewind();
+			double age = (double)(rxbus.head() - rxbus.tail()) *
+				SCBLOCKSIZE / current_samplerate;
+			trx_history_mark(age);
+			// Catching up at one spare block per live block takes as
+			// long as the history; allow half that rate
+			clock_gettime(CLOCK_MONOTONIC, &replay_end);
+			replay_end = replay_end + 2.0 * age;
+		}
+
+		if (!replaying) {
+			active_modem->rx_process(dbuf, numread);
+			modem_reader.sync();
+			continue;
+		}
+
+		// Spend at most half a block period on the history
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		t0 = t0 + 0.5 * numread / current_samplerate;
+		QRUNNER_DROP(true);
+		while ((blk = modem_reader.get())) {
+			if (blk->samplerate == current_samplerate)
+				active_modem->rx_process(blk->data, blk->len);
+			modem_reader.release(blk);
+			clock_gettime(CLOCK_MONOTONIC, &t1);
+			if (t1 > t0)
+				break;
+		}
+		QRUNNER_DROP(false);
+
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		if (!modem_reader.at_head() && t1 > replay_end) {
+			// the modem cannot decode fast enough to ever catch up
+			modem_reader.sync();
+			put_status("History replay too slow, rest skipped", 5);
+		}
+		if (modem_reader.at_head()) {
+			replaying = false;
+			trx_history_end(afc);
 		}
 	}
 	if (scard->must_close(O_RDONLY))
@@ -433,8 +532,10 @@ void *trx_loop(void *args)
 	for (;;) {
 		if (unlikely(old_state != trx_state)) {
 			old_state = trx_state;
-			if (trx_state == STATE_TX || trx_state == STATE_TUNE)
+			if (trx_state == STATE_TX || trx_state == STATE_TUNE) {
 				trxrb.reset();
+				rxbus.reset();
+			}
 			trx_signal_state();
 		}
 /*
@@ -94,7 +94,7 @@ void Digiscope::video(double *data, int len , bool dir)
 		memcpy(vidbuf, vidline, 3 * W * sizeof(unsigned char));
 	}
 
-	REQ_DROP(&Digiscope::redraw, this);
+	ui_redraw(this);
 	FL_UNLOCK_D();
 	FL_AWAKE_D();
 }
@@ -111,7 +111,7 @@ void Digiscope::zdata(complex *zarray, int len )
 		_zdata[_zptr++] = zarray[i];
 		if (_zptr == MAX_ZLEN) _zptr = 0;
 	}
-	REQ_DROP(&Digiscope::redraw, this);
+	ui_redraw(this);
 	FL_UNLOCK_D();
 	FL_AWAKE_D();
 }
@@ -122,7 +122,7 @@ void Digiscope::data(double *data, int len, bool scale)
 	
 	if (data == 0) {
 		memset(_buf, 0, MAX_LEN * sizeof(*_buf));
-    	REQ_DROP(&Digiscope::redraw, this);
+    	ui_redraw(this);
 		return;
 	}
 	if (len == 0)
@@ -143,7 +143,7 @@ void Digiscope::data(double *data, int len, bool scale)
 		for (int i = 0; i < _len; i++)
 			_buf[i] = (_buf[i] - min) / (max - min);
 	}
-	REQ_DROP(&Digiscope::redraw, this);
+	ui_redraw(this);
 	FL_UNLOCK_D();
 	FL_AWAKE_D();
 }
@@ -156,7 +156,7 @@ void Digiscope::phase(double ph, double ql, bool hl)
 	_phase = ph;
 	_quality = ql;
 	_highlight = hl;
-	REQ_DROP(&Digiscope::redraw, this);
+	ui_redraw(this);
 	FL_UNLOCK_D();
 	FL_AWAKE_D();
 }
@@ -169,7 +169,7 @@ void Digiscope::rtty(double flo, double fhi, double amp)
 	_flo = flo;
 	_fhi = fhi;
 	_amp = amp;
-	REQ_DROP(&Digiscope::redraw, this);
+	ui_redraw(this);
 	FL_UNLOCK_D();
 	FL_AWAKE_D();
 }
@@ -196,7 +196,7 @@ void Digiscope::mode(scope_mode md)
 	vidline[3*W/2+2] = 0;
 	for (int i = 0; i < H; i++)
 		memcpy(&vidbuf[3*W*i], vidline, 3*W*sizeof(unsigned char) );
-	REQ_DROP(&Digiscope::redraw, this);
+	ui_redraw(this);
 	FL_UNLOCK_D();
 	FL_AWAKE_D();
 }